@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace JackCompiler
+{
+  /**
+  * Append an unsigned value to data as numBytes little endian bytes
+  */
+  inline void writeValue(std::string& data, std::uint64_t value, unsigned numBytes)
+  {
+    for (unsigned i = 0; i < numBytes; ++i)
+      data.push_back((char)((value >> (8 * i)) & 0xFF));
+  }
+
+  /**
+  * Append a string to data, preceded by its length as 4 bytes
+  */
+  inline void writeString(std::string& data, const std::string& value)
+  {
+    writeValue(data, value.size(), 4);
+    data.append(value);
+  }
+
+  /**
+  * Reads values written by writeValue and writeString back out of a block of data, remembering if it ever ran off the end
+  */
+  struct BinaryReader
+  {
+    const std::string& m_data;
+    std::size_t m_position;
+    bool m_valid;
+
+    BinaryReader(const std::string& data, std::size_t position) : m_data(data), m_position(position), m_valid(true) {}
+
+    std::uint64_t readValue(unsigned numBytes)
+    {
+      if (m_position + numBytes > m_data.size())
+      {
+        m_valid = false;
+        return 0;
+      }
+
+      std::uint64_t value = 0;
+      for (unsigned i = 0; i < numBytes; ++i)
+        value |= (std::uint64_t)(unsigned char)m_data[m_position++] << (8 * i);
+      return value;
+    }
+
+    std::string readString()
+    {
+      std::size_t length = readValue(4);
+      if (!m_valid || m_position + length > m_data.size())
+      {
+        m_valid = false;
+        return "";
+      }
+      m_position += length;
+      return m_data.substr(m_position - length, length);
+    }
+
+    /**
+    * Returns a boolean indicating whether every read succeeded and all of the data has been read
+    */
+    bool readAll() const { return m_valid && m_position == m_data.size(); }
+  };
+}
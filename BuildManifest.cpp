@@ -0,0 +1,83 @@
+#include "BuildManifest.h"
+#include "BinaryData.h"
+#include "FileUtilities.h"
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char s_manifestMagic[4] = {'J', 'C', 'M', 'F'};
+    const std::uint8_t s_manifestVersion = 2;
+  }
+
+  const std::string BuildManifest::m_fileName = ".jackcache";
+
+  bool BuildManifest::load(const std::string& filePath, std::uint64_t environmentKey)
+  {
+    m_entries.clear();
+    std::string data;
+    if (!readFile(filePath, data))
+      return false;
+
+    if (data.size() < sizeof(s_manifestMagic) + 1 || data.compare(0, sizeof(s_manifestMagic), s_manifestMagic, sizeof(s_manifestMagic)) != 0 || (std::uint8_t)data[sizeof(s_manifestMagic)] != s_manifestVersion)
+      return false;
+
+    BinaryReader reader(data, sizeof(s_manifestMagic) + 1);
+    if (reader.readValue(8) != environmentKey)
+      return false;
+
+    std::map<std::string, ManifestEntry> entries;
+    for (std::uint64_t i = reader.readValue(4); i > 0 && reader.m_valid; --i)
+    {
+      std::string fileName = reader.readString();
+      ManifestEntry entry;
+      entry.m_sourceHash = reader.readValue(8);
+      entry.m_codeSize = reader.readValue(8);
+      entry.m_codeModifiedSeconds = reader.readValue(8);
+      entry.m_codeModifiedNanoseconds = reader.readValue(8);
+      //a file without a class is stored with an empty interface
+      std::string interfaceData = reader.readString();
+      if (!interfaceData.empty() && !ClassInterface::deserialise(interfaceData, entry.m_interface))
+        reader.m_valid = false;
+      for (std::size_t j = 0; j < entry.m_interface.m_dependencies.size() && reader.m_valid; ++j)
+        entry.m_dependencyHashes.push_back(reader.readValue(8));
+      deserialiseWarnings(reader, entry.m_warnings);
+      entries[fileName] = entry;
+    }
+
+    if (!reader.readAll())
+      return false;
+
+    m_entries = entries;
+    return true;
+  }
+
+  void BuildManifest::save(const std::string& filePath, std::uint64_t environmentKey) const
+  {
+    std::string data(s_manifestMagic, sizeof(s_manifestMagic));
+    data.push_back((char)s_manifestVersion);
+    writeValue(data, environmentKey, 8);
+    writeValue(data, m_entries.size(), 4);
+    for (auto& entry : m_entries)
+    {
+      writeString(data, entry.first);
+      writeValue(data, entry.second.m_sourceHash, 8);
+      writeValue(data, entry.second.m_codeSize, 8);
+      writeValue(data, entry.second.m_codeModifiedSeconds, 8);
+      writeValue(data, entry.second.m_codeModifiedNanoseconds, 8);
+      writeString(data, entry.second.m_interface.m_className.empty() ? "" : entry.second.m_interface.serialise());
+      for (std::uint64_t dependencyHash : entry.second.m_dependencyHashes)
+        writeValue(data, dependencyHash, 8);
+      serialiseWarnings(data, entry.second.m_warnings);
+    }
+
+    //Write to a temporary file first so that an interrupted build never leaves a partially written manifest behind
+    writeFileAtomically(filePath, data.data(), data.size());
+  }
+
+  const ManifestEntry* BuildManifest::findEntry(const std::string& fileName) const
+  {
+    auto entry = m_entries.find(fileName);
+    return entry == m_entries.end() ? nullptr : &entry->second;
+  }
+}
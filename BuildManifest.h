@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "Core.h"
+#include "ClassInterface.h"
+
+namespace JackCompiler
+{
+  /**
+  * What was compiled from a jack file in the last successful build, and what it was compiled against
+  */
+  struct ManifestEntry
+  {
+    //hash of the contents of the jack file
+    std::uint64_t m_sourceHash = 0;
+    //size and modification time of the vm file that was written, used to notice a vm file that has since been changed or deleted
+    std::int64_t m_codeSize = 0;
+    std::int64_t m_codeModifiedSeconds = 0;
+    std::int64_t m_codeModifiedNanoseconds = 0;
+    //the class's interface, whose dependencies are the classes the file refers to
+    ClassInterface m_interface;
+    //declarations hash of each dependency when the file was compiled, 0 for classes that are not part of the program
+    std::vector<std::uint64_t> m_dependencyHashes;
+    //the warnings reported when the file was compiled, reported again whenever the file is reused
+    std::vector<Diagnostic> m_warnings;
+  };
+
+  /**
+  * A manifest kept in the directory being compiled that maps each jack file to the vm code built from it, so that a file whose
+  * contents and dependencies have not changed does not have to be compiled again
+  */
+  class BuildManifest
+  {
+  public:
+    /**
+    * Read the manifest at filePath. Returns false, leaving the manifest empty, if the file does not exist, is not a well formed
+    * manifest or was written by a different compiler or against different libraries, as given by the environment key
+    */
+    bool load(const std::string& filePath, std::uint64_t environmentKey);
+    /**
+    * Write the manifest to filePath, tagged with the environment key. Failing to write it is not an error, the files will just
+    * be compiled again next time
+    */
+    void save(const std::string& filePath, std::uint64_t environmentKey) const;
+    /**
+    * Return the entry for the file with the given name, or nullptr if the manifest has no entry for it
+    */
+    const ManifestEntry* findEntry(const std::string& fileName) const;
+    void setEntry(const std::string& fileName, const ManifestEntry& entry) { m_entries[fileName] = entry; }
+    const std::map<std::string, ManifestEntry>& getEntries() const { return m_entries; }
+
+    //Name of the manifest written inside the compiled directory
+    static const std::string m_fileName;
+
+  private:
+    //entries are keyed by the name of the jack file within the directory
+    std::map<std::string, ManifestEntry> m_entries;
+  };
+}
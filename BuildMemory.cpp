@@ -0,0 +1,116 @@
+#include "BuildMemory.h"
+#include "FileUtilities.h"
+
+#include <algorithm>
+#include <vector>
+#include <climits>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace JackCompiler
+{
+  std::string BuildMemory::getAbsolutePath(const std::string& filePath) const
+  {
+    char workingDirectory[PATH_MAX];
+    if (filePath.empty() || filePath[0] == '/' || getcwd(workingDirectory, sizeof(workingDirectory)) == nullptr)
+      return filePath;
+    return std::string(workingDirectory) + "/" + filePath;
+  }
+
+  bool BuildMemory::getSourceHashes(const std::string& filePath, std::uint64_t& sourceHash, std::string& sourceDigest)
+  {
+    struct stat status;
+    if (stat(filePath.c_str(), &status) != 0)
+      return false;
+
+    //A file with the size and modification time it had when it was last read still has the same contents
+    SourceFile& sourceFile = m_sourceFiles[getAbsolutePath(filePath)];
+    if (sourceFile.m_sourceDigest.empty() || sourceFile.m_size != (std::int64_t)status.st_size || sourceFile.m_modifiedSeconds != (std::int64_t)status.st_mtim.tv_sec ||
+        sourceFile.m_modifiedNanoseconds != (std::int64_t)status.st_mtim.tv_nsec)
+    {
+      std::string source;
+      if (!readFile(filePath, source))
+        return false;
+
+      sourceFile = SourceFile();
+      sourceFile.m_size = status.st_size;
+      sourceFile.m_modifiedSeconds = status.st_mtim.tv_sec;
+      sourceFile.m_modifiedNanoseconds = status.st_mtim.tv_nsec;
+      sourceFile.m_sourceHash = hashContent(source.data(), source.size());
+      sourceFile.m_sourceDigest = CompilationCache::hashSource(source);
+    }
+
+    sourceHash = sourceFile.m_sourceHash;
+    sourceDigest = sourceFile.m_sourceDigest;
+    return true;
+  }
+
+  bool BuildMemory::findDeclarations(const std::string& filePath, std::uint64_t sourceHash, ClassInterface& declarations) const
+  {
+    auto sourceFile = m_sourceFiles.find(getAbsolutePath(filePath));
+    if (sourceFile == m_sourceFiles.end() || !sourceFile->second.m_scanned || sourceFile->second.m_sourceHash != sourceHash)
+      return false;
+
+    declarations = sourceFile->second.m_declarations;
+    return true;
+  }
+
+  void BuildMemory::setDeclarations(const std::string& filePath, std::uint64_t sourceHash, const ClassInterface& declarations)
+  {
+    auto sourceFile = m_sourceFiles.find(getAbsolutePath(filePath));
+    if (sourceFile == m_sourceFiles.end() || sourceFile->second.m_sourceHash != sourceHash)
+      return;
+
+    sourceFile->second.m_scanned = true;
+    sourceFile->second.m_declarations = declarations;
+  }
+
+  bool BuildMemory::findCompilation(const std::string& key, CachedCompilation& compilation)
+  {
+    std::lock_guard<std::mutex> lock(m_compilationsMutex);
+    auto rememberedCompilation = m_compilations.find(key);
+    if (rememberedCompilation == m_compilations.end())
+      return false;
+
+    rememberedCompilation->second.m_lastUsedBuild = m_buildNumber;
+    compilation = rememberedCompilation->second.m_compilation;
+    return true;
+  }
+
+  void BuildMemory::storeCompilation(const std::string& key, const CachedCompilation& compilation)
+  {
+    std::uint64_t size = key.size();
+    for (const Diagnostic& warning : compilation.m_warnings)
+      size += warning.m_message.size() + warning.m_filePath.size() + sizeof(Diagnostic);
+    size += compilation.m_outputCode.size() * sizeof(VmInstruction);
+    for (const std::string& name : compilation.m_outputCode.getNames())
+      size += name.size() + sizeof(std::string);
+
+    std::lock_guard<std::mutex> lock(m_compilationsMutex);
+    auto rememberedCompilation = m_compilations.find(key);
+    if (rememberedCompilation != m_compilations.end())
+      m_compilationsSize -= rememberedCompilation->second.m_size;
+    m_compilations[key] = {compilation, size, m_buildNumber};
+    m_compilationsSize += size;
+  }
+
+  void BuildMemory::finishBuild()
+  {
+    std::lock_guard<std::mutex> lock(m_compilationsMutex);
+    ++m_buildNumber;
+    if (m_compilationsSize <= m_maxCompilationsSize)
+      return;
+
+    std::vector<std::pair<std::uint64_t, std::string>> keysByLastUse;
+    for (auto& rememberedCompilation : m_compilations)
+      keysByLastUse.push_back({rememberedCompilation.second.m_lastUsedBuild, rememberedCompilation.first});
+    std::sort(keysByLastUse.begin(), keysByLastUse.end());
+
+    for (std::size_t i = 0; i < keysByLastUse.size() && m_compilationsSize > m_maxCompilationsSize / 10 * 9; ++i)
+    {
+      auto rememberedCompilation = m_compilations.find(keysByLastUse[i].second);
+      m_compilationsSize -= rememberedCompilation->second.m_size;
+      m_compilations.erase(rememberedCompilation);
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include "ClassInterface.h"
+#include "CompilationCache.h"
+
+namespace JackCompiler
+{
+  /**
+  * What a compiler kept running as a server remembers from one build to the next: the hashes of the source files it has read,
+  * the declarations scanned from them and the files it compiled recently. A source file is only read again once its size or
+  * modification time changes
+  */
+  class BuildMemory
+  {
+  public:
+    BuildMemory(std::uint64_t maxCompilationsSize = 256ull * 1024 * 1024) : m_maxCompilationsSize(maxCompilationsSize) {}
+    /**
+    * Set the hash of the source at filePath and its digest for use in a compilation cache key, returning false if the file
+    * cannot be read
+    */
+    bool getSourceHashes(const std::string& filePath, std::uint64_t& sourceHash, std::string& sourceDigest);
+    /**
+    * Find the declarations scanned from the file at filePath when it had the given source hash
+    */
+    bool findDeclarations(const std::string& filePath, std::uint64_t sourceHash, ClassInterface& declarations) const;
+    void setDeclarations(const std::string& filePath, std::uint64_t sourceHash, const ClassInterface& declarations);
+    /**
+    * Look up a compilation by its compilation cache key. Safe to call from several threads at once
+    */
+    bool findCompilation(const std::string& key, CachedCompilation& compilation);
+    void storeCompilation(const std::string& key, const CachedCompilation& compilation);
+    /**
+    * Mark the end of a build, forgetting the least recently used compilations if they take up more than the limit
+    */
+    void finishBuild();
+
+  private:
+    struct SourceFile
+    {
+      std::int64_t m_size;
+      std::int64_t m_modifiedSeconds;
+      std::int64_t m_modifiedNanoseconds;
+      std::uint64_t m_sourceHash;
+      std::string m_sourceDigest;
+      //the declarations are only known once the file has been scanned
+      bool m_scanned = false;
+      ClassInterface m_declarations;
+    };
+
+    struct RememberedCompilation
+    {
+      CachedCompilation m_compilation;
+      std::uint64_t m_size;
+      std::uint64_t m_lastUsedBuild;
+    };
+
+    /**
+    * Return the absolute path of the file, as builds are run from different working directories
+    */
+    std::string getAbsolutePath(const std::string& filePath) const;
+
+    //source files keyed by absolute path
+    std::map<std::string, SourceFile> m_sourceFiles;
+    std::mutex m_compilationsMutex;
+    std::unordered_map<std::string, RememberedCompilation> m_compilations;
+    std::uint64_t m_compilationsSize = 0;
+    std::uint64_t m_maxCompilationsSize;
+    std::uint64_t m_buildNumber = 0;
+  };
+}
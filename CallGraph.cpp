@@ -0,0 +1,80 @@
+#include "CallGraph.h"
+
+#include <sstream>
+
+namespace JackCompiler
+{
+  void CallGraph::addFile(const std::string& filePath, const std::string& code)
+  {
+    File& file = m_files[filePath];
+    file.m_code = code;
+
+    //Only the function and call instructions matter, so the first two words of each line are all that is read
+    std::size_t lineStart = 0;
+    while (lineStart < code.size())
+    {
+      std::size_t lineEnd = code.find('\n', lineStart);
+      if (lineEnd == std::string::npos)
+        lineEnd = code.size();
+
+      std::istringstream line(code.substr(lineStart, lineEnd - lineStart));
+      std::string command, name;
+      line >> command >> name;
+      if (command == "function")
+      {
+        if (!file.m_subroutines.empty())
+          file.m_subroutines.back().m_end = lineStart;
+        file.m_subroutines.push_back({name, lineStart, code.size(), {}});
+      }
+      else if (command == "call" && !file.m_subroutines.empty())
+        file.m_subroutines.back().m_calls.push_back(name);
+
+      lineStart = lineEnd + 1;
+    }
+
+    for (std::size_t i = 0; i < file.m_subroutines.size(); ++i)
+      m_subroutines[file.m_subroutines[i].m_name] = {&file, i};
+  }
+
+  bool CallGraph::isDefined(const std::string& name) const
+  {
+    return m_subroutines.count(name) != 0;
+  }
+
+  std::set<std::string> CallGraph::findReachable(const std::vector<std::string>& roots) const
+  {
+    std::set<std::string> reachable;
+    std::vector<std::string> toVisit(roots.begin(), roots.end());
+    while (!toVisit.empty())
+    {
+      std::string name = toVisit.back();
+      toVisit.pop_back();
+      auto subroutine = m_subroutines.find(name);
+      if (subroutine == m_subroutines.end() || !reachable.insert(name).second)
+        continue;
+
+      const File& file = *subroutine->second.first;
+      for (const std::string& call : file.m_subroutines[subroutine->second.second].m_calls)
+        toVisit.push_back(call);
+    }
+    return reachable;
+  }
+
+  std::string CallGraph::removeUnreachable(const std::string& filePath, const std::set<std::string>& reachable, std::vector<RemovedSubroutine>& removed) const
+  {
+    const File& file = m_files.at(filePath);
+    if (file.m_subroutines.empty())
+      return file.m_code;
+
+    //anything before the first subroutine is kept as it is
+    std::string code = file.m_code.substr(0, file.m_subroutines.front().m_start);
+    for (const Subroutine& subroutine : file.m_subroutines)
+    {
+      if (reachable.count(subroutine.m_name) != 0)
+        code.append(file.m_code, subroutine.m_start, subroutine.m_end - subroutine.m_start);
+      else
+        removed.push_back({subroutine.m_name, subroutine.m_end - subroutine.m_start});
+    }
+    return code;
+  }
+}
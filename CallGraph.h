@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+namespace JackCompiler
+{
+  /**
+  * The subroutines defined in the vm files of a program and the subroutines each of them calls, read from the vm code so that
+  * classes reused from a cache or an earlier build are included just like the ones compiled
+  */
+  class CallGraph
+  {
+  public:
+    /**
+    * A subroutine left out of a file, and the number of bytes of vm code it took up
+    */
+    struct RemovedSubroutine
+    {
+      std::string m_name;
+      std::size_t m_numBytes;
+    };
+
+    /**
+    * Add the subroutines defined by the vm code of the file at filePath
+    */
+    void addFile(const std::string& filePath, const std::string& code);
+    /**
+    * Return true if one of the files added defines the subroutine with the given name
+    */
+    bool isDefined(const std::string& name) const;
+    /**
+    * Return the names of the subroutines that can be reached by calls from the roots. Calls to subroutines the program does not
+    * define, such as those of the operating system, lead nowhere
+    */
+    std::set<std::string> findReachable(const std::vector<std::string>& roots) const;
+    /**
+    * Return the code of the file added at filePath without the subroutines that are not reachable, adding them to removed
+    */
+    std::string removeUnreachable(const std::string& filePath, const std::set<std::string>& reachable, std::vector<RemovedSubroutine>& removed) const;
+
+  private:
+    struct Subroutine
+    {
+      std::string m_name;
+      //where the subroutine's code starts in the file and ends, at the start of the next subroutine or the end of the file
+      std::size_t m_start;
+      std::size_t m_end;
+      std::vector<std::string> m_calls;
+    };
+
+    struct File
+    {
+      std::string m_code;
+      std::vector<Subroutine> m_subroutines;
+    };
+
+    std::unordered_map<std::string, File> m_files;
+    //the file each subroutine is defined in, and its position in the file's subroutines
+    std::unordered_map<std::string, std::pair<const File*, std::size_t>> m_subroutines;
+  };
+}
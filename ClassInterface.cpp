@@ -0,0 +1,341 @@
+#include "ClassInterface.h"
+#include "PassTimer.h"
+
+#include <cstdint>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char s_interfaceMagic[4] = {'J', 'C', 'I', 'F'};
+    const std::uint8_t s_interfaceVersion = 1;
+
+    void writeCount(std::string& data, std::size_t count)
+    {
+      data.push_back((char)(count & 0xFF));
+      data.push_back((char)((count >> 8) & 0xFF));
+    }
+
+    void writeString(std::string& data, const std::string& value)
+    {
+      writeCount(data, value.size());
+      data.append(value);
+    }
+
+    //Reads values back out of an interface file, remembering if it ever ran off the end of the data
+    struct InterfaceReader
+    {
+      const std::string& m_data;
+      std::size_t m_position;
+      bool m_valid;
+
+      std::uint8_t readByte()
+      {
+        if (m_position >= m_data.size())
+        {
+          m_valid = false;
+          return 0;
+        }
+        return (std::uint8_t)m_data[m_position++];
+      }
+
+      std::size_t readCount()
+      {
+        std::size_t low = readByte();
+        return low | ((std::size_t)readByte() << 8);
+      }
+
+      std::string readString()
+      {
+        std::size_t length = readCount();
+        if (!m_valid || m_position + length > m_data.size())
+        {
+          m_valid = false;
+          return "";
+        }
+        m_position += length;
+        return m_data.substr(m_position - length, length);
+      }
+
+      Symbol::SymbolKind readKind()
+      {
+        std::uint8_t kind = readByte();
+        if (kind > (std::uint8_t)Symbol::SymbolKind::CLASS)
+          m_valid = false;
+        return (Symbol::SymbolKind)kind;
+      }
+    };
+  }
+
+  ClassInterface ClassInterface::fromSymbolTable(const SymbolTable& classSymbolTable)
+  {
+    ClassInterface classInterface;
+    classInterface.m_className = classSymbolTable.getTableName();
+    std::size_t prefixLength = classInterface.m_className.size() + 1;
+
+    //the symbols are held in declaration order, which is also the order their offsets were assigned in
+    for (auto symbol : classSymbolTable.getSymbols())
+    {
+      std::string name = symbol->m_name.substr(prefixLength);
+      if (symbol->m_kind == Symbol::SymbolKind::FIELD || symbol->m_kind == Symbol::SymbolKind::STATIC)
+        classInterface.m_variables.push_back({name, symbol->m_kind, symbol->m_type});
+      else if (symbol->getParameterList())
+        classInterface.m_subroutines.push_back({name, symbol->m_kind, symbol->m_type, *symbol->getParameterList()});
+    }
+
+    return classInterface;
+  }
+
+  SymbolTable ClassInterface::toSymbolTable() const
+  {
+    SymbolTable classSymbolTable(m_className);
+    for (const VariableDeclaration& variable : m_variables)
+      classSymbolTable.addSymbol(m_className + "." + variable.m_name, variable.m_kind, variable.m_type);
+
+    for (const SubroutineDeclaration& subroutine : m_subroutines)
+      classSymbolTable.addSymbol(m_className + "." + subroutine.m_name, subroutine.m_kind, subroutine.m_returnType, subroutine.m_parameterTypes);
+
+    return classSymbolTable;
+  }
+
+  std::string ClassInterface::serialise() const
+  {
+    std::string data(s_interfaceMagic, sizeof(s_interfaceMagic));
+    data.push_back((char)s_interfaceVersion);
+    writeString(data, m_className);
+
+    writeCount(data, m_variables.size());
+    for (const VariableDeclaration& variable : m_variables)
+    {
+      data.push_back((char)variable.m_kind);
+      writeString(data, variable.m_name);
+      writeString(data, variable.m_type);
+    }
+
+    writeCount(data, m_subroutines.size());
+    for (const SubroutineDeclaration& subroutine : m_subroutines)
+    {
+      data.push_back((char)subroutine.m_kind);
+      writeString(data, subroutine.m_name);
+      writeString(data, subroutine.m_returnType);
+      writeCount(data, subroutine.m_parameterTypes.size());
+      for (const std::string& parameterType : subroutine.m_parameterTypes)
+        writeString(data, parameterType);
+    }
+
+    writeCount(data, m_dependencies.size());
+    for (const std::string& dependency : m_dependencies)
+      writeString(data, dependency);
+
+    return data;
+  }
+
+  bool ClassInterface::deserialise(const std::string& data, ClassInterface& classInterface)
+  {
+    if (data.size() < sizeof(s_interfaceMagic) + 1 || data.compare(0, sizeof(s_interfaceMagic), s_interfaceMagic, sizeof(s_interfaceMagic)) != 0 || (std::uint8_t)data[sizeof(s_interfaceMagic)] != s_interfaceVersion)
+      return false;
+
+    InterfaceReader reader {data, sizeof(s_interfaceMagic) + 1, true};
+    classInterface = ClassInterface();
+    classInterface.m_className = reader.readString();
+
+    for (std::size_t i = reader.readCount(); i > 0 && reader.m_valid; --i)
+    {
+      VariableDeclaration variable;
+      variable.m_kind = reader.readKind();
+      variable.m_name = reader.readString();
+      variable.m_type = reader.readString();
+      classInterface.m_variables.push_back(variable);
+    }
+
+    for (std::size_t i = reader.readCount(); i > 0 && reader.m_valid; --i)
+    {
+      SubroutineDeclaration subroutine;
+      subroutine.m_kind = reader.readKind();
+      subroutine.m_name = reader.readString();
+      subroutine.m_returnType = reader.readString();
+      for (std::size_t j = reader.readCount(); j > 0 && reader.m_valid; --j)
+        subroutine.m_parameterTypes.push_back(reader.readString());
+      classInterface.m_subroutines.push_back(subroutine);
+    }
+
+    for (std::size_t i = reader.readCount(); i > 0 && reader.m_valid; --i)
+      classInterface.m_dependencies.push_back(reader.readString());
+
+    return reader.m_valid && reader.m_position == data.size() && !classInterface.m_className.empty();
+  }
+
+  bool ClassInterface::declaresSameMembers(const ClassInterface& other) const
+  {
+    if (m_className != other.m_className || m_variables.size() != other.m_variables.size() || m_subroutines.size() != other.m_subroutines.size())
+      return false;
+
+    for (std::size_t i = 0; i < m_variables.size(); ++i)
+    {
+      if (m_variables[i].m_name != other.m_variables[i].m_name || m_variables[i].m_kind != other.m_variables[i].m_kind || m_variables[i].m_type != other.m_variables[i].m_type)
+        return false;
+    }
+
+    for (std::size_t i = 0; i < m_subroutines.size(); ++i)
+    {
+      if (m_subroutines[i].m_name != other.m_subroutines[i].m_name || m_subroutines[i].m_kind != other.m_subroutines[i].m_kind ||
+          m_subroutines[i].m_returnType != other.m_subroutines[i].m_returnType || m_subroutines[i].m_parameterTypes != other.m_subroutines[i].m_parameterTypes)
+        return false;
+    }
+
+    return true;
+  }
+
+  std::uint64_t ClassInterface::getDeclarationsHash() const
+  {
+    ClassInterface declarations = *this;
+    declarations.m_dependencies.clear();
+    std::string data = declarations.serialise();
+    return hashContent(data.data(), data.size());
+  }
+
+  ClassInterface InterfaceScanner::scan()
+  {
+    ScopedPassTimer passTimer(Pass::SCANNING);
+    ClassInterface classInterface;
+
+    //if file is empty
+    if (m_lexer.peekNextToken().m_tokenType == Token::TokenType::EOFILE)
+      return classInterface;
+
+    Token token = m_lexer.getNextToken();
+    if (token.m_lexeme != "class")
+      compilerError("Expected the KEYWORD 'class' at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+
+    classInterface.m_className = identifier();
+    expectSymbol("{");
+
+    Token nextToken = m_lexer.peekNextToken();
+    while (nextToken.m_lexeme == "static" || nextToken.m_lexeme == "field" || nextToken.m_lexeme == "constructor" || nextToken.m_lexeme == "function" || nextToken.m_lexeme == "method")
+    {
+      memberDeclaration(classInterface);
+      nextToken = m_lexer.peekNextToken();
+    }
+
+    expectSymbol("}");
+    if ((token = m_lexer.getNextToken()).m_tokenType != Token::TokenType::EOFILE)
+      compilerError("Expected the EOF token at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+
+    m_referencedNames.erase(classInterface.m_className);
+    classInterface.m_dependencies.assign(m_referencedNames.begin(), m_referencedNames.end());
+    return classInterface;
+  }
+
+  void InterfaceScanner::memberDeclaration(ClassInterface& classInterface)
+  {
+    Token nextToken = m_lexer.peekNextToken();
+    if (nextToken.m_lexeme == "static" || nextToken.m_lexeme == "field")
+      variableDeclaration(classInterface);
+    else
+      subroutineDeclaration(classInterface);
+  }
+
+  void InterfaceScanner::variableDeclaration(ClassInterface& classInterface)
+  {
+    Symbol::SymbolKind kind = m_lexer.getNextToken().m_lexeme == "static" ? Symbol::SymbolKind::STATIC : Symbol::SymbolKind::FIELD;
+    std::string variableType = type(false);
+    classInterface.m_variables.push_back({identifier(), kind, variableType});
+    while (m_lexer.peekNextToken().m_lexeme == ",")
+    {
+      m_lexer.getNextToken();
+      classInterface.m_variables.push_back({identifier(), kind, variableType});
+    }
+    expectSymbol(";");
+  }
+
+  void InterfaceScanner::subroutineDeclaration(ClassInterface& classInterface)
+  {
+    std::string keyword = m_lexer.getNextToken().m_lexeme;
+    SubroutineDeclaration subroutine;
+    if (keyword == "constructor")
+      subroutine.m_kind = Symbol::SymbolKind::CONSTRUCTOR;
+    else if (keyword == "function")
+      subroutine.m_kind = Symbol::SymbolKind::FUNCTION;
+    else
+      subroutine.m_kind = Symbol::SymbolKind::METHOD;
+
+    subroutine.m_returnType = type(true);
+    subroutine.m_name = identifier();
+    expectSymbol("(");
+    if (m_lexer.peekNextToken().m_lexeme != ")")
+    {
+      subroutine.m_parameterTypes.push_back(type(false));
+      identifier();
+      while (m_lexer.peekNextToken().m_lexeme == ",")
+      {
+        m_lexer.getNextToken();
+        subroutine.m_parameterTypes.push_back(type(false));
+        identifier();
+      }
+    }
+    expectSymbol(")");
+    skipBody();
+
+    classInterface.m_subroutines.push_back(subroutine);
+  }
+
+  void InterfaceScanner::skipBody()
+  {
+    Token token = m_lexer.getNextToken();
+    if (token.m_lexeme == ";")
+      return;
+
+    if (token.m_lexeme != "{")
+      compilerError("Expected the SYMBOL '{' at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+
+    //comments and string constants are consumed by the lexer, so any braces seen here belong to the body
+    unsigned depth = 1;
+    Token previousToken;
+    while (depth > 0)
+    {
+      token = m_lexer.getNextToken();
+      if (token.m_tokenType == Token::TokenType::EOFILE)
+        compilerError("Expected the SYMBOL '}' before the end of the file : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+      else if (token.m_lexeme == "{")
+        ++depth;
+      else if (token.m_lexeme == "}")
+        --depth;
+      //the type of a local variable, or the class or variable name in front of a qualified call
+      else if (token.m_tokenType == Token::TokenType::IDENTIFIER && previousToken.m_lexeme == "var")
+        m_referencedNames.insert(token.m_lexeme);
+      else if (token.m_lexeme == "." && previousToken.m_tokenType == Token::TokenType::IDENTIFIER)
+        m_referencedNames.insert(previousToken.m_lexeme);
+
+      previousToken = token;
+    }
+  }
+
+  std::string InterfaceScanner::type(bool allowVoid)
+  {
+    Token token = m_lexer.getNextToken();
+    if (token.m_tokenType == Token::TokenType::IDENTIFIER)
+      m_referencedNames.insert(token.m_lexeme);
+
+    if (token.m_lexeme == "int" || token.m_lexeme == "char" || token.m_lexeme == "boolean" || token.m_tokenType == Token::TokenType::IDENTIFIER || (allowVoid && token.m_lexeme == "void"))
+      return token.m_lexeme;
+
+    compilerError("Expected the KEYWORD 'int', the KEYWORD 'char', the KEYWORD 'boolean' or an IDENTIFIER at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+    return "";
+  }
+
+  std::string InterfaceScanner::identifier()
+  {
+    Token token = m_lexer.getNextToken();
+    if (token.m_tokenType != Token::TokenType::IDENTIFIER)
+      compilerError("Expected an IDENTIFIER at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+
+    return token.m_lexeme;
+  }
+
+  void InterfaceScanner::expectSymbol(const std::string& symbol)
+  {
+    Token token = m_lexer.getNextToken();
+    if (token.m_lexeme != symbol)
+      compilerError("Expected the SYMBOL '" + symbol + "' at this position : " + m_filePath, m_lexer.getLineNum(), token.m_lexeme);
+  }
+}
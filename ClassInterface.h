@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+
+#include "Core.h"
+#include "Lexer.h"
+#include "SymbolTable.h"
+
+namespace JackCompiler
+{
+  struct VariableDeclaration
+  {
+    std::string m_name;
+    Symbol::SymbolKind m_kind;
+    std::string m_type;
+  };
+
+  struct SubroutineDeclaration
+  {
+    std::string m_name;
+    Symbol::SymbolKind m_kind;
+    std::string m_returnType;
+    std::vector<std::string> m_parameterTypes;
+  };
+
+  /**
+  * The declarations a class exposes to the rest of the program - everything needed to type check code that uses the class.
+  * Member names are stored without the class name prefix
+  */
+  struct ClassInterface
+  {
+    std::string m_className;
+    std::vector<VariableDeclaration> m_variables;
+    std::vector<SubroutineDeclaration> m_subroutines;
+    //Names of the other classes this class refers to, used to decide what has to be rebuilt when an interface changes
+    std::vector<std::string> m_dependencies;
+
+    /**
+    * Build the interface of a class from its symbol table once the class has been compiled
+    */
+    static ClassInterface fromSymbolTable(const SymbolTable& classSymbolTable);
+    /**
+    * Build a class symbol table holding the declarations, so code using the class can be checked without compiling it
+    */
+    SymbolTable toSymbolTable() const;
+    /**
+    * Encode the interface in the compact binary format used by interface files
+    */
+    std::string serialise() const;
+    /**
+    * Decode an interface file, returning false if the data is not a well formed interface
+    */
+    static bool deserialise(const std::string& data, ClassInterface& classInterface);
+    /**
+    * Returns a boolean indicating whether two interfaces declare the same members - the dependencies are not compared
+    */
+    bool declaresSameMembers(const ClassInterface& other) const;
+    /**
+    * Return a hash of the members the class declares, which is equal for two interfaces that declare the same members
+    */
+    std::uint64_t getDeclarationsHash() const;
+  };
+
+  class InterfaceScanner
+  {
+  public:
+    InterfaceScanner(const std::string& filePath) : m_lexer(filePath), m_filePath(filePath) {}
+    /**
+    * Read the class and member declarations of the file without compiling the subroutine bodies, which are skipped by matching braces.
+    * A subroutine may also be declared without a body by ending it with ';', so library stubs only need to contain signatures.
+    * The dependencies are filled in with every name used as a data type or as the target of a qualified call, which is a cheap
+    * over-approximation of the classes the file refers to
+    */
+    ClassInterface scan();
+
+  private:
+    void memberDeclaration(ClassInterface& classInterface);
+    void variableDeclaration(ClassInterface& classInterface);
+    void subroutineDeclaration(ClassInterface& classInterface);
+    /**
+    * Consume a subroutine body, or the ';' ending a body-less declaration
+    */
+    void skipBody();
+    /**
+    * Consume the next token, raising an error if it is not a valid data type, and return the type
+    */
+    std::string type(bool allowVoid);
+    /**
+    * Consume the next token, raising an error if it is not an IDENTIFIER, and return its lexeme
+    */
+    std::string identifier();
+    void expectSymbol(const std::string& symbol);
+
+    Lexer m_lexer;
+    std::string m_filePath;
+    //Names that may refer to other classes, collected while scanning
+    std::set<std::string> m_referencedNames;
+  };
+}
@@ -0,0 +1,246 @@
+#include "CompilationCache.h"
+#include "BinaryData.h"
+#include "FileUtilities.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char s_entryMagic[4] = {'J', 'C', 'C', 'E'};
+    const std::uint8_t s_entryVersion = 11;
+    const std::string s_statisticsFileName = "stats";
+    const std::string s_lockFileName = "lock";
+
+    std::string toHex(std::uint64_t value)
+    {
+      const char digits[] = "0123456789abcdef";
+      std::string hex(16, '0');
+      for (int i = 15; i >= 0; --i, value >>= 4)
+        hex[i] = digits[value & 0xF];
+      return hex;
+    }
+
+    struct CacheEntryFile
+    {
+      std::string m_path;
+      std::uint64_t m_size;
+      struct timespec m_lastUsed;
+    };
+  }
+
+  std::string CompilationCache::hashSource(const std::string& source)
+  {
+    //Trailing whitespace and carriage returns are dropped from each line. Line breaks are kept as the warnings refer to line numbers
+    std::string data;
+    std::size_t lineStart = 0;
+    while (lineStart <= source.size())
+    {
+      std::size_t lineEnd = source.find('\n', lineStart);
+      if (lineEnd == std::string::npos)
+        lineEnd = source.size();
+
+      std::size_t contentEnd = lineEnd;
+      while (contentEnd > lineStart && (source[contentEnd - 1] == ' ' || source[contentEnd - 1] == '\t' || source[contentEnd - 1] == '\r'))
+        --contentEnd;
+      data.append(source, lineStart, contentEnd - lineStart).push_back('\n');
+      lineStart = lineEnd + 1;
+    }
+
+    return toHex(hashContent(data.data(), data.size())) + toHex(hashContent(data.data(), data.size(), 0x9E3779B97F4A7C15ull));
+  }
+
+  std::string CompilationCache::makeKey(std::uint64_t environmentKey, const std::string& sourceDigest, const std::vector<std::pair<std::string, std::uint64_t>>& dependencyHashes)
+  {
+    std::string data;
+    writeValue(data, environmentKey, 8);
+    writeString(data, sourceDigest);
+    for (auto& dependencyHash : dependencyHashes)
+    {
+      writeString(data, dependencyHash.first);
+      writeValue(data, dependencyHash.second, 8);
+    }
+
+    //two differently seeded hashes make a 128 bit key, so that unrelated compilations never share an entry
+    return toHex(hashContent(data.data(), data.size())) + toHex(hashContent(data.data(), data.size(), 0x9E3779B97F4A7C15ull));
+  }
+
+  std::string CompilationCache::getEntryPath(const std::string& key) const
+  {
+    //entries are spread over subdirectories named after the first two characters of the key to keep the directories small
+    return m_directoryPath + "/" + key.substr(0, 2) + "/" + key.substr(2);
+  }
+
+  bool CompilationCache::lookup(const std::string& key, CachedCompilation& compilation)
+  {
+    std::string data;
+    bool found = readFile(getEntryPath(key), data) && data.size() > sizeof(s_entryMagic) && data.compare(0, sizeof(s_entryMagic), s_entryMagic, sizeof(s_entryMagic)) == 0 &&
+                 (std::uint8_t)data[sizeof(s_entryMagic)] == s_entryVersion;
+
+    if (found)
+    {
+      BinaryReader reader(data, sizeof(s_entryMagic) + 1);
+      compilation = CachedCompilation();
+      compilation.m_compileMicroseconds = reader.readValue(8);
+      deserialiseWarnings(reader, compilation.m_warnings);
+      std::string interfaceData = reader.readString();
+      if (!interfaceData.empty() && !ClassInterface::deserialise(interfaceData, compilation.m_interface))
+        reader.m_valid = false;
+      if (reader.m_valid)
+        compilation.m_outputCode.deserialise(reader);
+      compilation.m_optimisationStatistics.deserialise(reader);
+      found = reader.readAll();
+    }
+
+    //the modification time of an entry records when it was last used, which decides the order entries are evicted in
+    if (found)
+      utimensat(AT_FDCWD, getEntryPath(key).c_str(), nullptr, 0);
+
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    if (found)
+    {
+      ++m_statistics.m_hits;
+      m_statistics.m_savedMicroseconds += compilation.m_compileMicroseconds;
+    }
+    else
+      ++m_statistics.m_misses;
+
+    return found;
+  }
+
+  void CompilationCache::store(const std::string& key, const CachedCompilation& compilation)
+  {
+    std::string data(s_entryMagic, sizeof(s_entryMagic));
+    data.push_back((char)s_entryVersion);
+    writeValue(data, compilation.m_compileMicroseconds, 8);
+    serialiseWarnings(data, compilation.m_warnings);
+    writeString(data, compilation.m_interface.m_className.empty() ? "" : compilation.m_interface.serialise());
+    compilation.m_outputCode.serialise(data);
+    compilation.m_optimisationStatistics.serialise(data);
+
+    mkdir(m_directoryPath.c_str(), 0777);
+    mkdir((m_directoryPath + "/" + key.substr(0, 2)).c_str(), 0777);
+    if (!writeFileAtomically(getEntryPath(key), data.data(), data.size()))
+      return;
+
+    std::lock_guard<std::mutex> lock(m_statisticsMutex);
+    ++m_statistics.m_stores;
+    m_storedBytes += data.size();
+  }
+
+  void CompilationCache::finish()
+  {
+    mkdir(m_directoryPath.c_str(), 0777);
+    //Builds sharing the store update the totals one at a time
+    int lockFile = open((m_directoryPath + "/" + s_lockFileName).c_str(), O_RDWR | O_CREAT, 0666);
+    if (lockFile == -1)
+      return;
+    flock(lockFile, LOCK_EX);
+
+    std::string statisticsData;
+    readFile(m_directoryPath + "/" + s_statisticsFileName, statisticsData);
+    std::istringstream statisticsStream(statisticsData);
+    std::string name;
+    std::uint64_t value;
+    m_totalStatistics = CacheStatistics();
+    m_size = 0;
+    while (statisticsStream >> name >> value)
+    {
+      if (name == "hits")
+        m_totalStatistics.m_hits = value;
+      else if (name == "misses")
+        m_totalStatistics.m_misses = value;
+      else if (name == "stores")
+        m_totalStatistics.m_stores = value;
+      else if (name == "evictions")
+        m_totalStatistics.m_evictions = value;
+      else if (name == "saved_microseconds")
+        m_totalStatistics.m_savedMicroseconds = value;
+      else if (name == "size")
+        m_size = value;
+    }
+
+    //the size is only counted from the entries stored, so it can overestimate when builds store the same entry - eviction
+    //measures the real size
+    m_size += m_storedBytes;
+    if (m_size > m_maxSize)
+      m_size = evict();
+
+    m_totalStatistics.m_hits += m_statistics.m_hits;
+    m_totalStatistics.m_misses += m_statistics.m_misses;
+    m_totalStatistics.m_stores += m_statistics.m_stores;
+    m_totalStatistics.m_evictions += m_statistics.m_evictions;
+    m_totalStatistics.m_savedMicroseconds += m_statistics.m_savedMicroseconds;
+
+    std::ostringstream newStatistics;
+    newStatistics << "hits " << m_totalStatistics.m_hits << "\n" << "misses " << m_totalStatistics.m_misses << "\n" << "stores " << m_totalStatistics.m_stores << "\n" <<
+                     "evictions " << m_totalStatistics.m_evictions << "\n" << "saved_microseconds " << m_totalStatistics.m_savedMicroseconds << "\n" << "size " << m_size << "\n";
+    std::string newStatisticsData = newStatistics.str();
+    writeFileAtomically(m_directoryPath + "/" + s_statisticsFileName, newStatisticsData.data(), newStatisticsData.size());
+
+    flock(lockFile, LOCK_UN);
+    close(lockFile);
+  }
+
+  std::uint64_t CompilationCache::evict()
+  {
+    std::vector<CacheEntryFile> entryFiles;
+    std::uint64_t size = 0;
+    DIR* directory = opendir(m_directoryPath.c_str());
+    if (directory == NULL)
+      return 0;
+
+    for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+    {
+      std::string subdirectoryName = entry->d_name;
+      if (subdirectoryName.size() != 2 || subdirectoryName == "..")
+        continue;
+
+      std::string subdirectoryPath = m_directoryPath + "/" + subdirectoryName;
+      DIR* subdirectory = opendir(subdirectoryPath.c_str());
+      if (subdirectory == NULL)
+        continue;
+
+      for (struct dirent* subentry = readdir(subdirectory); subentry != NULL; subentry = readdir(subdirectory))
+      {
+        std::string entryPath = subdirectoryPath + "/" + subentry->d_name;
+        struct stat status;
+        if (subentry->d_name[0] != '.' && stat(entryPath.c_str(), &status) == 0 && S_ISREG(status.st_mode))
+        {
+          entryFiles.push_back({entryPath, (std::uint64_t)status.st_size, status.st_mtim});
+          size += status.st_size;
+        }
+      }
+      closedir(subdirectory);
+    }
+    closedir(directory);
+
+    std::sort(entryFiles.begin(), entryFiles.end(), [](const CacheEntryFile& a, const CacheEntryFile& b)
+    {
+      return a.m_lastUsed.tv_sec != b.m_lastUsed.tv_sec ? a.m_lastUsed.tv_sec < b.m_lastUsed.tv_sec : a.m_lastUsed.tv_nsec < b.m_lastUsed.tv_nsec;
+    });
+
+    //evicting down to 90% of the limit means the next few builds do not each have to walk the store again
+    std::uint64_t targetSize = m_maxSize / 10 * 9;
+    for (const CacheEntryFile& entryFile : entryFiles)
+    {
+      if (size <= targetSize)
+        break;
+      if (std::remove(entryFile.m_path.c_str()) == 0)
+      {
+        size -= entryFile.m_size;
+        ++m_statistics.m_evictions;
+      }
+    }
+
+    return size;
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "Core.h"
+#include "ClassInterface.h"
+#include "VmCode.h"
+#include "VmOptimiser.h"
+
+namespace JackCompiler
+{
+  /**
+  * Everything a successful compilation of one file produced, enough to stand in for compiling the file again
+  */
+  struct CachedCompilation
+  {
+    VmCode m_outputCode;
+    //the warnings reported while compiling the file. The file path of each is not stored, as the entry can be used for a file anywhere
+    std::vector<Diagnostic> m_warnings;
+    //the interface of the class, left empty if the file holds no class
+    ClassInterface m_interface;
+    //how long the compilation took, reported as time saved whenever the entry is used
+    std::uint64_t m_compileMicroseconds = 0;
+    //what optimising the code did, reported again whenever the entry is used
+    OptimisationStatistics m_optimisationStatistics;
+  };
+
+  struct CacheStatistics
+  {
+    std::uint64_t m_hits = 0;
+    std::uint64_t m_misses = 0;
+    std::uint64_t m_stores = 0;
+    std::uint64_t m_evictions = 0;
+    std::uint64_t m_savedMicroseconds = 0;
+  };
+
+  /**
+  * A content addressed store of compiled files that can be shared by any number of projects, checkouts and processes. An entry is
+  * found by a key made from everything the compilation depends on, so it never has to be invalidated - entries that stop being
+  * used are evicted, least recently used first, once the store grows past its size limit
+  */
+  class CompilationCache
+  {
+  public:
+    CompilationCache(const std::string& directoryPath, std::uint64_t maxSize) : m_directoryPath(directoryPath), m_maxSize(maxSize) {}
+    /**
+    * Return a digest of the source of a file for use in a key. The source is normalised first, so line ending and trailing
+    * whitespace changes do not cause a miss
+    */
+    static std::string hashSource(const std::string& source);
+    /**
+    * Make a key from the compiler environment, the digest of the source of a file and the declarations of the classes it depends on
+    */
+    static std::string makeKey(std::uint64_t environmentKey, const std::string& sourceDigest, const std::vector<std::pair<std::string, std::uint64_t>>& dependencyHashes);
+    /**
+    * Look up the compilation stored under key, returning false on a miss. Safe to call from several threads at once
+    */
+    bool lookup(const std::string& key, CachedCompilation& compilation);
+    /**
+    * Store a compilation under key. Failing to store it is not an error. Safe to call from several threads at once
+    */
+    void store(const std::string& key, const CachedCompilation& compilation);
+    /**
+    * Add the counts from this build to the totals kept in the store and evict the least recently used entries if it has grown
+    * past its size limit
+    */
+    void finish();
+    const CacheStatistics& getStatistics() const { return m_statistics; }
+    const CacheStatistics& getTotalStatistics() const { return m_totalStatistics; }
+    std::uint64_t getSize() const { return m_size; }
+    std::uint64_t getMaxSize() const { return m_maxSize; }
+
+  private:
+    std::string getEntryPath(const std::string& key) const;
+    /**
+    * Remove the least recently used entries until the store is comfortably below its size limit, returning its new size
+    */
+    std::uint64_t evict();
+
+    std::string m_directoryPath;
+    std::uint64_t m_maxSize;
+    std::mutex m_statisticsMutex;
+    CacheStatistics m_statistics;
+    //bytes stored by this build
+    std::uint64_t m_storedBytes = 0;
+    CacheStatistics m_totalStatistics;
+    std::uint64_t m_size = 0;
+  };
+}
@@ -0,0 +1,271 @@
+#include "CompileServer.h"
+#include "Compiler.h"
+#include "Core.h"
+#include "BinaryData.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <climits>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char s_requestMagic[4] = {'J', 'C', 'S', 'R'};
+    const std::uint8_t s_protocolVersion = 1;
+    const char s_buildRequest = 'B';
+    const char s_stopRequest = 'S';
+    //a message larger than this did not come from a client or server speaking the protocol
+    const std::uint64_t s_maxMessageSize = 64 * 1024 * 1024;
+
+    volatile std::sig_atomic_t s_stopRequested = 0;
+
+    void requestStop(int)
+    {
+      s_stopRequested = 1;
+    }
+
+    bool sendAll(int connection, const char* data, std::size_t size)
+    {
+      while (size > 0)
+      {
+        ssize_t numBytesSent = send(connection, data, size, MSG_NOSIGNAL);
+        if (numBytesSent < 0 && errno == EINTR)
+          continue;
+        if (numBytesSent < 0)
+          return false;
+        data += numBytesSent;
+        size -= numBytesSent;
+      }
+      return true;
+    }
+
+    bool receiveAll(int connection, char* data, std::size_t size)
+    {
+      while (size > 0)
+      {
+        ssize_t numBytesReceived = recv(connection, data, size, 0);
+        if (numBytesReceived < 0 && errno == EINTR)
+          continue;
+        if (numBytesReceived <= 0)
+          return false;
+        data += numBytesReceived;
+        size -= numBytesReceived;
+      }
+      return true;
+    }
+
+    //Each message is preceded by its length, so that either side knows when it has received all of it
+    bool sendMessage(int connection, const std::string& message)
+    {
+      std::string frame;
+      writeValue(frame, message.size(), 4);
+      frame.append(message);
+      return sendAll(connection, frame.data(), frame.size());
+    }
+
+    bool receiveMessage(int connection, std::string& message)
+    {
+      std::string header(4, '\0');
+      if (!receiveAll(connection, &header[0], header.size()))
+        return false;
+
+      BinaryReader reader(header, 0);
+      std::uint64_t size = reader.readValue(4);
+      if (size > s_maxMessageSize)
+        return false;
+      message.resize(size);
+      return receiveAll(connection, &message[0], size);
+    }
+
+    sockaddr_un getSocketAddress(const std::string& socketPath)
+    {
+      sockaddr_un address;
+      std::memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+        compilerError("Invalid socket path \"" + socketPath + "\"");
+      std::strcpy(address.sun_path, socketPath.c_str());
+      return address;
+    }
+
+    /**
+    * Connect to the socket at socketPath, returning -1 if no server is listening on it
+    */
+    int connectToSocket(const std::string& socketPath)
+    {
+      sockaddr_un address = getSocketAddress(socketPath);
+      int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (connection != -1 && connect(connection, (sockaddr*)&address, sizeof(address)) != 0)
+      {
+        close(connection);
+        return -1;
+      }
+      return connection;
+    }
+  }
+
+  int CompileServer::listenOnSocket() const
+  {
+    //A socket left behind by a server that was killed is replaced, but a running server is left alone
+    int existingServer = connectToSocket(m_socketPath);
+    if (existingServer != -1)
+    {
+      close(existingServer);
+      compilerError("A compile server is already listening on \"" + m_socketPath + "\"");
+    }
+
+    struct stat status;
+    if (lstat(m_socketPath.c_str(), &status) == 0)
+    {
+      if (!S_ISSOCK(status.st_mode))
+        compilerError("\"" + m_socketPath + "\" exists and is not a socket");
+      unlink(m_socketPath.c_str());
+    }
+
+    sockaddr_un address = getSocketAddress(m_socketPath);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1 || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+      if (listener != -1)
+        close(listener);
+      compilerError("Unable to listen on \"" + m_socketPath + "\"");
+    }
+    return listener;
+  }
+
+  int CompileServer::run()
+  {
+    int listener;
+    try
+    {
+      listener = listenOnSocket();
+    }
+    catch (const CompilationError&)
+    {
+      return 1;
+    }
+
+    //Interrupting the server lets it remove its socket before exiting, so accept must not be restarted after a signal
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::cout << "Compile server listening on " << m_socketPath << std::endl;
+    bool serving = true;
+    while (serving && !s_stopRequested)
+    {
+      int connection = accept(listener, nullptr, nullptr);
+      if (connection == -1)
+        continue;
+      serving = serveConnection(connection);
+      close(connection);
+    }
+
+    close(listener);
+    unlink(m_socketPath.c_str());
+    return 0;
+  }
+
+  bool CompileServer::serveConnection(int connection)
+  {
+    std::string request;
+    if (!receiveMessage(connection, request) || request.size() < sizeof(s_requestMagic) + 2 || request.compare(0, sizeof(s_requestMagic), s_requestMagic, sizeof(s_requestMagic)) != 0 ||
+        (std::uint8_t)request[sizeof(s_requestMagic)] != s_protocolVersion)
+      return true;
+
+    BinaryReader reader(request, sizeof(s_requestMagic) + 1);
+    char requestType = (char)reader.readValue(1);
+    std::string response;
+    if (requestType == s_stopRequest)
+    {
+      writeValue(response, 0, 1);
+      writeString(response, "Compile server on " + m_socketPath + " stopped\n");
+      sendMessage(connection, response);
+      return false;
+    }
+
+    std::string workingDirectory = reader.readString();
+    std::vector<std::string> arguments(1, "JackCompiler");
+    for (std::uint64_t numArguments = reader.readValue(4); numArguments > 0 && reader.m_valid; --numArguments)
+      arguments.push_back(reader.readString());
+    if (requestType != s_buildRequest || !reader.readAll())
+      return true;
+
+    //The build is run from the client's working directory, so relative paths and the file names in the output are exactly what a
+    //build run by the client itself would use
+    std::ostringstream output;
+    int result = 1;
+    try
+    {
+      DiagnosticsStreamScope diagnosticsStreamScope(output);
+      if (chdir(workingDirectory.c_str()) != 0)
+        compilerError("Unable to build in the directory \"" + workingDirectory + "\"");
+
+      std::vector<char*> argv;
+      for (std::string& argument : arguments)
+        argv.push_back(&argument[0]);
+      result = Compiler(output, &m_memory).run(argv.size(), argv.data());
+    }
+    catch (const CompilationError&)
+    {
+    }
+
+    writeValue(response, result, 1);
+    writeString(response, output.str());
+    sendMessage(connection, response);
+    return true;
+  }
+
+  int CompileServer::runClient(const std::string& socketPath, int argc, char** argv)
+  {
+    bool stop = argc == 2 && std::string(argv[1]) == "--stop";
+    std::string response;
+    try
+    {
+      int connection = connectToSocket(socketPath);
+      if (connection == -1 && !stop)
+        return Compiler().run(argc, argv);
+      if (connection == -1)
+        compilerError("No compile server is listening on \"" + socketPath + "\"");
+
+      char workingDirectory[PATH_MAX];
+      if (getcwd(workingDirectory, sizeof(workingDirectory)) == nullptr)
+        compilerError("Unable to read the working directory");
+
+      std::string request(s_requestMagic, sizeof(s_requestMagic));
+      writeValue(request, s_protocolVersion, 1);
+      writeValue(request, stop ? s_stopRequest : s_buildRequest, 1);
+      writeString(request, workingDirectory);
+      writeValue(request, argc - 1, 4);
+      for (int i = 1; i < argc; ++i)
+        writeString(request, argv[i]);
+
+      bool answered = sendMessage(connection, request) && receiveMessage(connection, response);
+      close(connection);
+      if (!answered)
+        compilerError("The compile server on \"" + socketPath + "\" did not answer");
+    }
+    catch (const CompilationError&)
+    {
+      return 1;
+    }
+
+    BinaryReader reader(response, 0);
+    int result = (int)reader.readValue(1);
+    std::string output = reader.readString();
+    std::cout << output << std::flush;
+    return reader.readAll() ? result : 1;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "BuildMemory.h"
+
+namespace JackCompiler
+{
+  /**
+  * Keeps a compiler running in the background, serving the builds requested by clients over a Unix domain socket. Builds are run
+  * one at a time and share one BuildMemory, so a repeated build only reads and compiles the files that changed since the builds
+  * before it
+  */
+  class CompileServer
+  {
+  public:
+    CompileServer(const std::string& socketPath) : m_socketPath(socketPath) {}
+    /**
+    * Serve builds until the process is interrupted or a client asks the server to stop. Returns 1 if the socket could not be set up
+    */
+    int run();
+    /**
+    * Run a build with the given command line arguments on the server listening at socketPath, printing its output. If no server
+    * is listening the build is run in this process instead. The argument --stop asks the server to stop
+    */
+    static int runClient(const std::string& socketPath, int argc, char** argv);
+
+  private:
+    /**
+    * Create the socket and start listening on it, returning the socket
+    */
+    int listenOnSocket() const;
+    /**
+    * Read a request from the connection and run it, returning false if the client asked the server to stop
+    */
+    bool serveConnection(int connection);
+
+    std::string m_socketPath;
+    BuildMemory m_memory;
+  };
+}
@@ -4,162 +4,1383 @@
 #include <dirent.h>
 #include <algorithm>
 #include <fstream>
+#include <set>
+#include <iterator>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <mutex>
+#include <limits>
 
 #include "Core.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "Library.h"
+#include "LibraryImage.h"
+#include "ClassInterface.h"
+#include "DependencyGraph.h"
+#include "CallGraph.h"
+#include "Inliner.h"
+#include "ProgramIndex.h"
+#include "ThreadPool.h"
+#include "FileUtilities.h"
+#include "PassTimer.h"
 
 namespace JackCompiler
 {
-  Compiler::Compiler()
-  {
-    //initialise the static memory segment offset to zero
-    SymbolTable::m_offsetStatic = 0;
-    addLibrarySymbols();
-  }
-
-  void Compiler::addLibrarySymbols()
-  {
-    //add Math class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Math"));
-    m_symbolTables.addToSymbolTables("Math.abs", Symbol::SymbolKind::FUNCTION, "int", {"int"});
-    m_symbolTables.addToSymbolTables("Math.multiply", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Math.divide", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Math.min", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Math.max", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Math.sqrt", Symbol::SymbolKind::FUNCTION, "int", {"int"});
-
-    //add Array class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Array"));
-    m_symbolTables.addToSymbolTables("Array.new", Symbol::SymbolKind::FUNCTION, "Array", {"int"});
-    m_symbolTables.addToSymbolTables("Array.dispose", Symbol::SymbolKind::METHOD, "void", {});
-
-    //add Memory class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Memory"));
-    m_symbolTables.addToSymbolTables("Memory.peek", Symbol::SymbolKind::FUNCTION, "int", {"int"});
-    m_symbolTables.addToSymbolTables("Memory.poke", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Memory.alloc", Symbol::SymbolKind::FUNCTION, "Array", {"int"});
-    m_symbolTables.addToSymbolTables("Memory.deAlloc", Symbol::SymbolKind::FUNCTION, "void", {"any"});
-
-    //add Screen class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Screen"));
-    m_symbolTables.addToSymbolTables("Screen.clearScreen", Symbol::SymbolKind::FUNCTION, "void", {});
-    m_symbolTables.addToSymbolTables("Screen.setColor", Symbol::SymbolKind::FUNCTION, "void", {"boolean"});
-    m_symbolTables.addToSymbolTables("Screen.drawPixel", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Screen.drawLine", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int", "int"});
-    m_symbolTables.addToSymbolTables("Screen.drawRectangle", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int", "int"});
-    m_symbolTables.addToSymbolTables("Screen.drawCircle", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int"});
-
-    //add Keyboard class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Keyboard"));
-    m_symbolTables.addToSymbolTables("Keyboard.keyPressed", Symbol::SymbolKind::FUNCTION, "char", {});
-    m_symbolTables.addToSymbolTables("Keyboard.readChar", Symbol::SymbolKind::FUNCTION, "char", {});
-    m_symbolTables.addToSymbolTables("Keyboard.readLine", Symbol::SymbolKind::FUNCTION, "String", {"String"});
-    m_symbolTables.addToSymbolTables("Keyboard.readInt", Symbol::SymbolKind::FUNCTION, "int", {"String"});
-
-    //add Output class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Output"));
-    m_symbolTables.addToSymbolTables("Output.init", Symbol::SymbolKind::FUNCTION, "void", {});
-    m_symbolTables.addToSymbolTables("Output.moveCursor", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"});
-    m_symbolTables.addToSymbolTables("Output.printChar", Symbol::SymbolKind::FUNCTION, "void", {"char"});
-    m_symbolTables.addToSymbolTables("Output.printString", Symbol::SymbolKind::FUNCTION, "void", {"String"});
-    m_symbolTables.addToSymbolTables("Output.printInt", Symbol::SymbolKind::FUNCTION, "void", {"int"});
-    m_symbolTables.addToSymbolTables("Output.printLn", Symbol::SymbolKind::FUNCTION, "void", {});
-    m_symbolTables.addToSymbolTables("Output.backSpace", Symbol::SymbolKind::FUNCTION, "void", {});
-
-    //add String class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("String"));
-    m_symbolTables.addToSymbolTables("String.new", Symbol::SymbolKind::CONSTRUCTOR, "String", {"int"});
-    m_symbolTables.addToSymbolTables("String.dispose", Symbol::SymbolKind::METHOD, "void", {});
-    m_symbolTables.addToSymbolTables("String.length", Symbol::SymbolKind::METHOD, "int", {});
-    m_symbolTables.addToSymbolTables("String.charAt", Symbol::SymbolKind::METHOD, "char", {"int"});
-    m_symbolTables.addToSymbolTables("String.setCharAt", Symbol::SymbolKind::METHOD, "void", {"int", "char"});
-    m_symbolTables.addToSymbolTables("String.appendChar", Symbol::SymbolKind::METHOD, "String", {"char"});
-    m_symbolTables.addToSymbolTables("String.eraseLastChar", Symbol::SymbolKind::METHOD, "void", {});
-    m_symbolTables.addToSymbolTables("String.intValue", Symbol::SymbolKind::METHOD, "int", {});
-    m_symbolTables.addToSymbolTables("String.setInt", Symbol::SymbolKind::METHOD, "void", {"int"});
-    m_symbolTables.addToSymbolTables("String.newLine", Symbol::SymbolKind::FUNCTION, "char", {});
-    m_symbolTables.addToSymbolTables("String.backSpace", Symbol::SymbolKind::FUNCTION, "char", {});
-    m_symbolTables.addToSymbolTables("String.doubleQuote", Symbol::SymbolKind::FUNCTION, "char", {});
-
-    //add Sys class subroutines
-    m_symbolTables.addSymbolTable(SymbolTable("Sys"));
-    m_symbolTables.addToSymbolTables("Sys.halt", Symbol::SymbolKind::FUNCTION, "void", {});
-    m_symbolTables.addToSymbolTables("Sys.error", Symbol::SymbolKind::FUNCTION, "void", {"int"});
-    m_symbolTables.addToSymbolTables("Sys.wait", Symbol::SymbolKind::FUNCTION, "void", {"int"});
-  }
-
-	int Compiler::run(int argc, char** argv)
-	{
+  namespace
+  {
+    /**
+    * Returns a boolean indicating whether the file at filePath exists, setting modificationTime if it does
+    */
+    bool getModificationTime(const std::string& filePath, struct timespec& modificationTime)
+    {
+      struct stat status;
+      if (stat(filePath.c_str(), &status) != 0)
+        return false;
+
+      modificationTime = status.st_mtim;
+      return true;
+    }
+
+    bool isNewerOrSame(const struct timespec& time, const struct timespec& otherTime)
+    {
+      return time.tv_sec > otherTime.tv_sec || (time.tv_sec == otherTime.tv_sec && time.tv_nsec >= otherTime.tv_nsec);
+    }
+
+    bool readInterfaceFile(const std::string& filePath, ClassInterface& classInterface)
+    {
+      std::string data;
+      return readFile(filePath, data) && ClassInterface::deserialise(data, classInterface);
+    }
+
+    /**
+    * Read a size given on the command line as a number of bytes, optionally followed by K, M or G
+    */
+    std::uint64_t parseSize(const std::string& size)
+    {
+      std::size_t numDigits = size.find_first_not_of("0123456789");
+      std::string suffix = numDigits == std::string::npos ? "" : size.substr(numDigits);
+      if (numDigits == 0 || size.size() > 12 || suffix.size() > 1 || suffix.find_first_not_of("KMGkmg") != std::string::npos)
+        compilerError("Invalid cache size \"" + size + "\"");
+
+      std::uint64_t value = std::stoull(size.substr(0, numDigits));
+      std::uint64_t multiplier = 1;
+      if (suffix == "K" || suffix == "k")
+        multiplier = 1024;
+      else if (suffix == "M" || suffix == "m")
+        multiplier = 1024 * 1024;
+      else if (suffix == "G" || suffix == "g")
+        multiplier = 1024 * 1024 * 1024;
+      //a size too large to count in bytes is rejected rather than wrapped around to a small one
+      if (value > std::numeric_limits<std::uint64_t>::max() / multiplier)
+        compilerError("Invalid cache size \"" + size + "\"");
+      return value * multiplier;
+    }
+
+    std::uint64_t getMicrosecondsSince(const std::chrono::steady_clock::time_point& startTime)
+    {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    /**
+    * Writes the code of a class to its vm file as it is generated. The file is only replaced once the sink is committed
+    */
+    class VmFileSink : public CodeSink
+    {
+    public:
+      VmFileSink(const std::string& filePath) : m_filePath(filePath), m_writer(filePath) {}
+
+      void writeCode(const VmCode& code) override
+      {
+        ScopedPassTimer passTimer(Pass::OUTPUT);
+        std::string text = code.toText();
+        if (!m_writer.write(text.data(), text.size()))
+          compilerError("Unable to output code to file '" + m_filePath + "'");
+      }
+
+      void commit()
+      {
+        ScopedPassTimer passTimer(Pass::OUTPUT);
+        if (!m_writer.commit())
+          compilerError("Unable to output code to file '" + m_filePath + "'");
+      }
+
+    private:
+      std::string m_filePath;
+      AtomicFileWriter m_writer;
+    };
+
+    /**
+    * Add the directories listed in the program list file at filePath to rootPaths. Each line holds one directory, and blank
+    * lines and lines starting with '#' are ignored
+    */
+    void readProgramList(const std::string& filePath, std::vector<std::string>& rootPaths)
+    {
+      std::string data;
+      if (!readFile(filePath, data))
+        compilerError("Unable to read the program list \"" + filePath + "\"");
+
+      std::istringstream lines(data);
+      std::string line;
+      while (std::getline(lines, line))
+      {
+        std::size_t start = line.find_first_not_of(" \t\r");
+        std::size_t end = line.find_last_not_of(" \t\r");
+        if (start != std::string::npos && line[start] != '#')
+          rootPaths.push_back(line.substr(start, end - start + 1));
+      }
+    }
+
+    /**
+    * Add every directory at or below directoryPath that contains a jack file to programPaths, in name order. Hidden directories
+    * and symbolic links are not followed
+    */
+    void findProgramsBelow(const std::string& directoryPath, std::vector<std::string>& programPaths)
+    {
+      DIR* directory = opendir(directoryPath.c_str());
+      if (directory == NULL)
+        compilerError("No directory exists with the name \"" + directoryPath + "\"");
+
+      bool hasJackFiles = false;
+      std::vector<std::string> subdirectoryPaths;
+      for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+      {
+        std::string name = entry->d_name;
+        std::string path = directoryPath + "/" + name;
+        struct stat status;
+        if (name.empty() || name[0] == '.' || lstat(path.c_str(), &status) != 0)
+          continue;
+        if (S_ISDIR(status.st_mode))
+          subdirectoryPaths.push_back(path);
+        else if (name.substr(name.find_last_of(".") + 1) == "jack")
+          hasJackFiles = true;
+      }
+      closedir(directory);
+
+      if (hasJackFiles)
+        programPaths.push_back(directoryPath);
+      std::sort(subdirectoryPaths.begin(), subdirectoryPaths.end());
+      for (const std::string& subdirectoryPath : subdirectoryPaths)
+        findProgramsBelow(subdirectoryPath, programPaths);
+    }
+
+    //the most instructions, apart from the function and return, a subroutine can have to be inlined. Enough for getters, setters
+    //and one line functions, which are the calls that cost far more than their bodies
+    const std::size_t s_maxInlinedInstructions = 8;
+
+    //An editor can save a file in several steps, and several files can be saved at once, so a rebuild waits for the changes to stop
+    const int s_debounceMilliseconds = 100;
+
+    /**
+    * Block until a jack file in the directory watched by the notifier changes, then until no further changes arrive for the
+    * debounce interval. Returns false if the directory can no longer be watched
+    */
+    bool waitForChanges(int notifier)
+    {
+      bool changed = false;
+      while (true)
+      {
+        struct pollfd pollEntry = {notifier, POLLIN, 0};
+        int numReady = poll(&pollEntry, 1, changed ? s_debounceMilliseconds : -1);
+        if (numReady == 0)
+          return true;
+        if (numReady < 0 && errno == EINTR)
+          continue;
+        if (numReady < 0)
+          return false;
+
+        alignas(struct inotify_event) char buffer[4096];
+        ssize_t length = read(notifier, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR)
+          continue;
+        if (length <= 0)
+          return false;
+
+        //The compiler's own output files are written to the same directory, so only events for jack files count as changes
+        for (char* position = buffer; position < buffer + length; )
+        {
+          const struct inotify_event* event = (const struct inotify_event*)position;
+          if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            return false;
+
+          std::string fileName = event->len > 0 ? event->name : "";
+          if ((event->mask & IN_Q_OVERFLOW) || (!fileName.empty() && fileName.substr(fileName.find_last_of(".") + 1) == "jack"))
+            changed = true;
+          position += sizeof(struct inotify_event) + event->len;
+        }
+      }
+    }
+
+    /**
+    * Report the warnings stored with a compilation of the file at filePath again, as though the file had just been compiled
+    */
+    void reportWarnings(const std::string& filePath, const std::vector<Diagnostic>& warnings)
+    {
+      for (Diagnostic warning : warnings)
+      {
+        warning.m_filePath = filePath;
+        reportDiagnostic(warning);
+      }
+    }
+
+    //The result of compiling one file on a worker thread, held until every file has been compiled
+    struct CompiledFile
+    {
+      //progress messages and warnings, exactly as the serial compile would have printed them before writing the file
+      std::string m_output;
+      std::vector<Diagnostic> m_diagnostics;
+      //the code, warnings and interface of the file, whether compiled or found in the shared cache
+      CachedCompilation m_compilation;
+      PassTimings m_passTimings;
+      //false if the compilation was found in the shared cache
+      bool m_compiled = false;
+      bool m_succeeded = false;
+    };
+  }
+
+  void Compiler::parseArguments(int argc, char** argv)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string argument = argv[i];
+      if (argument == "--interfaces")
+        m_options.m_useInterfaces = true;
+      else if (argument == "--no-cache")
+        m_options.m_useCache = false;
+      else if (argument == "--cache-dir" || argument == "--cache-size" || argument == "--diagnostics-json" || argument == "--time-passes-json")
+      {
+        if (i + 1 == argc)
+          compilerError("No value supplied after " + argument);
+        if (argument == "--cache-dir")
+          m_options.m_cacheDirectory = argv[++i];
+        else if (argument == "--cache-size")
+          m_options.m_cacheMaxSize = parseSize(argv[++i]);
+        else if (argument == "--diagnostics-json")
+          m_options.m_diagnosticsPath = argv[++i];
+        else
+        {
+          m_options.m_timePassesPath = argv[++i];
+          m_options.m_timePasses = true;
+        }
+      }
+      else if (argument == "--time-passes")
+        m_options.m_timePasses = true;
+      else if (argument == "-O" || argument == "--optimise")
+        m_options.m_optimise = true;
+      else if (argument == "--whole-program")
+        m_options.m_wholeProgram = true;
+      else if (argument == "--inline")
+      {
+        m_options.m_inline = true;
+        m_options.m_wholeProgram = true;
+      }
+      else if (argument == "--root")
+      {
+        if (i + 1 == argc)
+          compilerError("No subroutine supplied after --root");
+        m_options.m_rootSubroutines.push_back(argv[++i]);
+        m_options.m_wholeProgram = true;
+      }
+      else if (argument == "--pool-strings")
+        m_options.m_poolStrings = true;
+      else if (argument == "--opt-stats")
+      {
+        m_options.m_optimise = true;
+        m_options.m_printOptimisationStatistics = true;
+      }
+      else if (argument == "--cache-stats")
+        m_options.m_printCacheStatistics = true;
+      else if (argument == "--watch")
+        m_options.m_watch = true;
+      else if (argument == "-q" || argument == "--quiet")
+        m_options.m_verbosity = Verbosity::QUIET;
+      else if (argument == "--silent")
+        m_options.m_verbosity = Verbosity::SILENT;
+      else if (argument == "-r" || argument == "--recursive")
+        m_options.m_recursive = true;
+      else if (argument.compare(0, 2, "-j") == 0)
+      {
+        //the number of threads may be attached to the option (-j8) or follow it (-j 8)
+        std::string numThreads = argument.substr(2);
+        if (numThreads.empty())
+        {
+          if (i + 1 == argc)
+            compilerError("No number of threads supplied after -j");
+          numThreads = argv[++i];
+        }
+
+        if (numThreads.empty() || numThreads.size() > 4 || numThreads.find_first_not_of("0123456789") != std::string::npos || std::stoi(numThreads) == 0)
+          compilerError("Invalid number of threads \"" + numThreads + "\"");
+        m_options.m_numThreads = std::stoi(numThreads);
+      }
+      else if (argument == "--lib")
+      {
+        if (i + 1 == argc)
+          compilerError("No library path supplied after --lib");
+        m_options.m_libraryPaths.push_back(argv[++i]);
+      }
+      else if (argument.size() > 1 && argument[0] == '-')
+        compilerError("Unknown option \"" + argument + "\"");
+      else if (argument.size() > 1 && argument[0] == '@')
+        readProgramList(argument.substr(1), m_options.m_rootPaths);
+      else
+        m_options.m_rootPaths.push_back(argument);
+    }
+
     //Make sure a directory path has been passed in as a command line argument
-		std::string directoryPath = "";
-		if (argc < 2)
-			compilerError("No directory name supplied");
-		else
-			directoryPath = argv[1];
-
-		DIR* directory;
-		struct dirent* entry;
-    //Use the dirent library to open the directory
-		directory = opendir(directoryPath.c_str());
-		if (directory == NULL)
-			compilerError("No directory exists with the name \"" + directoryPath + "\"");
-
-    //For each jack file in the directory, add its path to a list
-		for (entry = readdir(directory); entry != NULL; entry = readdir(directory))
-		{
-			std::string fileString = directoryPath + "/" + entry->d_name;
-			if (fileString.substr(fileString.find_last_of(".") + 1) == "jack")
-				m_filePaths.push_back(fileString);
-		}
-
-		if (m_filePaths.empty())
+    if (m_options.m_rootPaths.empty())
+      compilerError("No directory name supplied");
+
+    //A single directory is compiled on its own, exactly as it always has been
+    if (m_options.m_rootPaths.size() == 1 && !m_options.m_recursive)
+      m_options.m_directoryPath = m_options.m_rootPaths.front();
+
+    //The shared cache can also be turned on for every build from the environment, which suits build machines
+    const char* cacheDirectory = std::getenv("JACK_CACHE_DIR");
+    if (m_options.m_cacheDirectory.empty() && cacheDirectory)
+      m_options.m_cacheDirectory = cacheDirectory;
+  }
+
+  int Compiler::run(int argc, char** argv)
+  {
+    m_options = CompilerOptions();
+    DiagnosticsStreamScope diagnosticsStreamScope(m_output);
+    try
+    {
+      parseArguments(argc, argv);
+      //a compile server would never finish the build, so a client cannot ask it to watch
+      if (m_options.m_watch && m_memory)
+        compilerError("The --watch option cannot be used with a compile server");
+      if (m_options.m_watch && m_options.m_directoryPath.empty())
+        compilerError("The --watch option can only be used with a single directory");
+      if (m_options.m_timePasses && !isPassTimingAvailable())
+        compilerError("The --time-passes option is not available as the compiler was built without JACK_PASS_TIMING");
+    }
+    catch (const CompilationError&)
+    {
+      return 1;
+    }
+
+    if (m_options.m_directoryPath.empty())
+      return buildPrograms();
+    if (!m_options.m_watch)
+      return build();
+
+    //Everything read and compiled is kept in memory while watching, so each rebuild only reads the files that changed
+    BuildMemory memory;
+    m_memory = &memory;
+    int result = watchDirectory();
+    m_memory = nullptr;
+    return result;
+  }
+
+  int Compiler::build()
+  {
+    //each build starts from a fresh context so that nothing is carried over from a previous compilation
+    m_context = CompilationContext();
+    PassStopwatch buildStopwatch;
+    if (m_options.m_timePasses)
+      buildStopwatch.start();
+
+    int result = 0;
+    {
+      PassTimingsScope passTimingsScope(m_options.m_timePasses ? &m_context.m_passTimings : nullptr);
+      try
+      {
+        DiagnosticsStreamScope diagnosticsStreamScope(m_output, &m_context.m_diagnostics, m_options.m_verbosity != Verbosity::SILENT);
+        compileDirectory();
+      }
+      catch (const CompilationError&)
+      {
+        //the error has already been reported
+        result = 1;
+      }
+
+      try
+      {
+        if (!m_options.m_diagnosticsPath.empty())
+          writeDiagnosticsFile(m_context.m_diagnostics);
+      }
+      catch (const CompilationError&)
+      {
+        result = 1;
+      }
+    }
+
+    if (m_memory)
+      m_memory->finishBuild();
+
+    //the counts are recorded for failed builds too, as the lookups they made still hit or missed
+    if (m_context.m_cache)
+    {
+      m_context.m_cache->finish();
+      if (m_options.m_printCacheStatistics)
+        printCacheStatistics();
+    }
+
+    if (m_options.m_printOptimisationStatistics && !m_loadedLibraries)
+      m_output << formatOptimisationStatistics(m_context.m_optimisationStatistics);
+
+    //a program built as part of a batch leaves its timings for the batch to report
+    if (m_options.m_timePasses)
+    {
+      m_context.m_buildTime = buildStopwatch.getElapsedTime();
+      try
+      {
+        if (!m_loadedLibraries)
+          reportPassTimings(m_context.m_passTimings, m_context.m_buildTime);
+      }
+      catch (const CompilationError&)
+      {
+        result = 1;
+      }
+    }
+
+    //the output is only flushed once the build is over, rather than line by line
+    m_output.flush();
+
+		//Return 0 if no errors occurred during compilation
+    return result;
+  }
+
+  void Compiler::reportPassTimings(const PassTimings& passTimings, const PassTime& buildTime) const
+  {
+    m_output << formatPassTimings(passTimings, buildTime);
+    if (m_options.m_timePassesPath.empty())
+      return;
+
+    std::string json = formatPassTimingsAsJson(passTimings, buildTime) + "\n";
+    if (!writeFileAtomically(m_options.m_timePassesPath, json.data(), json.size()))
+      compilerError("Unable to output pass timings to file '" + m_options.m_timePassesPath + "'");
+  }
+
+  void Compiler::writeDiagnosticsFile(const std::vector<Diagnostic>& diagnostics) const
+  {
+    ScopedPassTimer passTimer(Pass::OUTPUT);
+    std::string text;
+    for (const Diagnostic& diagnostic : diagnostics)
+      text.append(formatDiagnosticAsJson(diagnostic)).push_back('\n');
+    if (!writeFileAtomically(m_options.m_diagnosticsPath, text.data(), text.size()))
+      compilerError("Unable to output diagnostics to file '" + m_options.m_diagnosticsPath + "'");
+  }
+
+  LoadedLibraries Compiler::loadLibraries() const
+  {
+    ScopedPassTimer passTimer(Pass::LIBRARIES);
+    //Libraries given on the command line are consulted before the standard library so that they can extend the OS classes
+    LoadedLibraries loadedLibraries;
+    for (const std::string& libraryPath : m_options.m_libraryPaths)
+    {
+      std::shared_ptr<LibraryImage> library = LibraryImage::load(libraryPath);
+      loadedLibraries.m_hashes.push_back(library->getDeclarationsHash());
+      loadedLibraries.m_libraries.push_back(library);
+    }
+    loadedLibraries.m_libraries.push_back(std::make_shared<StandardLibrary>());
+    return loadedLibraries;
+  }
+
+  std::vector<std::string> Compiler::findPrograms() const
+  {
+    std::vector<std::string> programPaths;
+    for (const std::string& rootPath : m_options.m_rootPaths)
+    {
+      if (!m_options.m_recursive)
+      {
+        programPaths.push_back(rootPath);
+        continue;
+      }
+
+      std::size_t numProgramsFound = programPaths.size();
+      findProgramsBelow(rootPath.size() > 1 && rootPath.back() == '/' ? rootPath.substr(0, rootPath.size() - 1) : rootPath, programPaths);
+      if (programPaths.size() == numProgramsFound)
+        compilerError("No jack files found below the directory \"" + rootPath + "\"");
+    }
+
+    return programPaths;
+  }
+
+  int Compiler::buildPrograms()
+  {
+    std::vector<std::string> programPaths;
+    LoadedLibraries libraries;
+    try
+    {
+      programPaths = findPrograms();
+      libraries = loadLibraries();
+    }
+    catch (const CompilationError&)
+    {
+      return 1;
+    }
+
+    //The programs are shared out over the threads, each being compiled serially on one thread. The output of each program is
+    //printed, in order, as soon as it and every program before it have finished
+    std::vector<std::string> outputs(programPaths.size());
+    std::vector<ProgramBuildResult> programResults(programPaths.size());
+    std::vector<int> results(programPaths.size(), -1);
+    std::size_t numProgramsPrinted = 0;
+    std::size_t numProgramsFailed = 0;
+    std::mutex outputMutex;
+    ThreadPool(m_options.m_numThreads).run(programPaths.size(), [&](std::size_t i)
+    {
+      CompilerOptions options = m_options;
+      options.m_directoryPath = programPaths[i];
+      options.m_numThreads = 1;
+      //the diagnostics of every program are written to the file together once the batch is finished
+      options.m_diagnosticsPath.clear();
+      //the memory can only be shared by programs that are built one after another
+      std::ostringstream output;
+      Compiler compiler(output, m_options.m_numThreads == 1 ? m_memory : nullptr);
+      compiler.buildProgram(options, libraries, programResults[i]);
+
+      std::lock_guard<std::mutex> lock(outputMutex);
+      outputs[i] = output.str();
+      results[i] = programResults[i].m_result;
+      for (; numProgramsPrinted < programPaths.size() && results[numProgramsPrinted] != -1; ++numProgramsPrinted)
+      {
+        if (results[numProgramsPrinted] != 0)
+          ++numProgramsFailed;
+        //a quiet batch only names the programs that failed or had something to report
+        if (m_options.m_verbosity != Verbosity::NORMAL && results[numProgramsPrinted] == 0 && outputs[numProgramsPrinted].empty())
+          continue;
+
+        m_output << outputs[numProgramsPrinted];
+        if (results[numProgramsPrinted] == 0)
+          m_output << "Program " << programPaths[numProgramsPrinted] << " compiled successfully" << std::endl;
+        else
+          m_output << "Program " << programPaths[numProgramsPrinted] << " failed to compile" << std::endl;
+        m_output << std::endl;
+        outputs[numProgramsPrinted].clear();
+      }
+    });
+
+    //The diagnostics and the timings of every program are reported together, the times being summed over the programs
+    std::vector<Diagnostic> diagnostics;
+    PassTimings passTimings;
+    PassTime buildTime;
+    OptimisationStatistics optimisationStatistics;
+    for (const ProgramBuildResult& programResult : programResults)
+    {
+      diagnostics.insert(diagnostics.end(), programResult.m_diagnostics.begin(), programResult.m_diagnostics.end());
+      passTimings.merge(programResult.m_passTimings);
+      buildTime += programResult.m_buildTime;
+      optimisationStatistics.merge(programResult.m_optimisationStatistics);
+    }
+
+    m_output << "Compiled " << programPaths.size() << " programs: " << programPaths.size() - numProgramsFailed << " succeeded, " << numProgramsFailed << " failed" << std::endl;
+    if (m_options.m_printOptimisationStatistics)
+      m_output << formatOptimisationStatistics(optimisationStatistics);
+    bool reported = true;
+    try
+    {
+      if (!m_options.m_diagnosticsPath.empty())
+        writeDiagnosticsFile(diagnostics);
+      if (m_options.m_timePasses)
+        reportPassTimings(passTimings, buildTime);
+    }
+    catch (const CompilationError&)
+    {
+      reported = false;
+    }
+
+    return numProgramsFailed == 0 && reported ? 0 : 1;
+  }
+
+  void Compiler::buildProgram(const CompilerOptions& options, const LoadedLibraries& libraries, ProgramBuildResult& result)
+  {
+    m_options = options;
+    m_loadedLibraries = &libraries;
+    result.m_result = build();
+    result.m_diagnostics = m_context.m_diagnostics;
+    result.m_passTimings = m_context.m_passTimings;
+    result.m_buildTime = m_context.m_buildTime;
+    result.m_optimisationStatistics = m_context.m_optimisationStatistics;
+  }
+
+  int Compiler::watchDirectory()
+  {
+    build();
+
+    //Only the directory itself is watched, as it is the only place jack files are compiled from
+    int notifier = inotify_init1(IN_CLOEXEC);
+    if (notifier == -1 || inotify_add_watch(notifier, m_options.m_directoryPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF) == -1)
+    {
+      try
+      {
+        compilerError("Unable to watch the directory \"" + m_options.m_directoryPath + "\"");
+      }
+      catch (const CompilationError&)
+      {
+        return 1;
+      }
+    }
+
+    m_output << "Watching " << m_options.m_directoryPath << " for changes..." << std::endl;
+    while (waitForChanges(notifier))
+    {
+      m_output << std::endl;
+      m_output << "Rebuilding " << m_options.m_directoryPath << "..." << std::endl;
+      m_output << std::endl;
+      build();
+      m_output << "Watching " << m_options.m_directoryPath << " for changes..." << std::endl;
+    }
+
+    close(notifier);
+    m_output << "Stopped watching " << m_options.m_directoryPath << std::endl;
+    return 1;
+  }
+
+	void Compiler::compileDirectory()
+	{
+    std::string directoryPath = m_options.m_directoryPath;
+
+    LoadedLibraries libraries = m_loadedLibraries ? *m_loadedLibraries : loadLibraries();
+    const std::vector<std::uint64_t>& libraryHashes = libraries.m_hashes;
+    m_context.m_libraries = libraries.m_libraries;
+    for (const auto& library : m_context.m_libraries)
+      m_context.m_symbolTables.addLibrary(library);
+
+    {
+      ScopedPassTimer passTimer(Pass::CHANGE_DETECTION);
+      DIR* directory;
+      struct dirent* entry;
+      //Use the dirent library to open the directory
+      directory = opendir(directoryPath.c_str());
+      if (directory == NULL)
+        compilerError("No directory exists with the name \"" + directoryPath + "\"");
+
+      //For each jack file in the directory, add its path to a list
+      for (entry = readdir(directory); entry != NULL; entry = readdir(directory))
+      {
+        std::string fileString = directoryPath + "/" + entry->d_name;
+        if (fileString.substr(fileString.find_last_of(".") + 1) == "jack")
+          m_context.m_filePaths.push_back(fileString);
+      }
+      closedir(directory);
+    }
+
+		if (m_context.m_filePaths.empty())
 			compilerError("Directory does not contain any jack files");
 
+    //A file left as it is would keep the subroutines removed from it by an earlier build, which a changed file may now call, so
+    //every file is compiled when the whole program is pruned
+    m_context.m_environmentKey = getEnvironmentKey(libraryHashes);
+    if (m_options.m_useCache && !m_options.m_wholeProgram)
+      loadCachedFiles();
+
+    if (m_options.m_useInterfaces && !m_options.m_wholeProgram)
+      loadUpToDateInterfaces();
+
+    scanDeclarations(m_context.m_filePaths);
+    orderFilesByDependencies();
+
+    if (!m_options.m_cacheDirectory.empty())
+      m_context.m_cache.reset(new CompilationCache(m_options.m_cacheDirectory, m_options.m_cacheMaxSize));
+    if (m_context.m_cache || m_memory)
+      computeCacheKeys();
+
     //Compile each jack file found in the directory
-		for (std::string filePath : m_filePaths)
-			compileFile(filePath);
+    if (m_options.m_numThreads == 1 || !compileFilesInParallel())
+    {
+      for (std::string filePath : m_context.m_filePaths)
+        compileFile(filePath);
+    }
 
     //if unresolved symbols exist then throw an error
-    if (!m_symbolsToBeResolved.empty())
-      compilerError("Symbol has not been resolved : " + m_symbolsToBeResolved.front().m_fileName, m_symbolsToBeResolved.front().m_lineNum, m_symbolsToBeResolved.front().m_name);
-		
-		//No errors occurred during compilation so return 0
-		return 0;
+    const std::list<SymbolToBeResolved>& symbolsToBeResolved = m_context.m_symbolsToBeResolved;
+    if (!symbolsToBeResolved.empty())
+    {
+      DiagnosticsLocationScope diagnosticsLocationScope(symbolsToBeResolved.front().m_fileName);
+      compilerError("Symbol has not been resolved : " + symbolsToBeResolved.front().m_fileName, symbolsToBeResolved.front().m_lineNum, symbolsToBeResolved.front().m_name);
+    }
+
+    //Interface files are only written once the whole program is known to be correct, otherwise a class calling a subroutine that
+    //does not exist would be treated as up to date on the next run and the error would never be reported again
+    for (auto& compiledInterface : m_context.m_compiledInterfaces)
+    {
+      if (m_options.m_useInterfaces && !compiledInterface.second.m_className.empty())
+        writeInterfaceFile(getOutputFilePath(compiledInterface.first, ".jif"), compiledInterface.second);
+    }
+
+    //A file reused from the manifest may never have had an interface file written for it
+    for (const std::string& filePath : m_context.m_cachedFilePaths)
+    {
+      struct timespec interfaceTime;
+      const ClassInterface& classInterface = m_context.m_manifest.findEntry(getFileName(filePath))->m_interface;
+      if (m_options.m_useInterfaces && !classInterface.m_className.empty() && !getModificationTime(getOutputFilePath(filePath, ".jif"), interfaceTime))
+        writeInterfaceFile(getOutputFilePath(filePath, ".jif"), classInterface);
+    }
+
+    if (m_options.m_wholeProgram)
+      optimiseWholeProgram();
+    else if (m_options.m_useCache)
+      saveManifest();
+
+    ScopedPassTimer passTimer(Pass::OUTPUT);
+    for (auto& compilation : m_context.m_compilationsToStore)
+    {
+      if (m_memory)
+        m_memory->storeCompilation(compilation.first, compilation.second);
+      if (m_context.m_cache)
+        m_context.m_cache->store(compilation.first, compilation.second);
+    }
 	}
 
-  void Compiler::writeOutputCodeToConsole(const std::vector<std::string>& outputCode) const
+  void Compiler::optimiseWholeProgram()
+  {
+    ScopedPassTimer passTimer(Pass::OUTPUT);
+    std::vector<std::string> vmFilePaths;
+    std::vector<std::string> originalCode;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      vmFilePaths.push_back(getOutputFilePath(filePath, ".vm"));
+      originalCode.emplace_back();
+      if (!readFile(vmFilePaths.back(), originalCode.back()))
+        compilerError("Unable to read the file '" + vmFilePaths.back() + "'");
+    }
+    std::vector<std::string> code = originalCode;
+
+    //Every class is read before any calls are inlined, so that a call can be inlined whichever file the subroutine is in
+    Inliner inliner(s_maxInlinedInstructions);
+    if (m_options.m_inline)
+    {
+      std::vector<VmCode> classes(vmFilePaths.size());
+      for (std::size_t i = 0; i < classes.size(); ++i)
+      {
+        if (!classes[i].parseText(code[i]))
+          compilerError("Unable to read the vm code in the file '" + vmFilePaths[i] + "'");
+        inliner.addClass(classes[i]);
+      }
+      for (std::size_t i = 0; i < classes.size(); ++i)
+      {
+        if (inliner.inlineCalls(classes[i]))
+          code[i] = classes[i].toText();
+      }
+    }
+
+    CallGraph callGraph;
+    for (std::size_t i = 0; i < vmFilePaths.size(); ++i)
+      callGraph.addFile(vmFilePaths[i], code[i]);
+
+    //Sys.init starts a program that includes its own operating system, which then calls Main.main. Nothing is written unless a
+    //root is found, as every subroutine would otherwise be removed
+    for (const std::string& root : m_options.m_rootSubroutines)
+    {
+      if (!callGraph.isDefined(root))
+        compilerError("The subroutine \"" + root + "\" given to --root is not defined by the program");
+    }
+    std::vector<std::string> roots {"Sys.init", "Main.main"};
+    roots.insert(roots.end(), m_options.m_rootSubroutines.begin(), m_options.m_rootSubroutines.end());
+    if (std::none_of(roots.begin(), roots.end(), [&callGraph](const std::string& root) { return callGraph.isDefined(root); }))
+      compilerError("The program defines neither Main.main nor Sys.init, so every subroutine would be removed. Use --root to name the subroutines to keep");
+    std::set<std::string> reachable = callGraph.findReachable(roots);
+
+    std::vector<CallGraph::RemovedSubroutine> removed;
+    for (std::size_t i = 0; i < vmFilePaths.size(); ++i)
+    {
+      code[i] = callGraph.removeUnreachable(vmFilePaths[i], reachable, removed);
+      if (code[i] != originalCode[i] && !writeFileAtomically(vmFilePaths[i], code[i].data(), code[i].size()))
+        compilerError("Unable to output code to file '" + vmFilePaths[i] + "'");
+    }
+
+    if (m_options.m_inline && m_options.m_verbosity == Verbosity::NORMAL)
+    {
+      m_output << "Inlined " << inliner.getNumCallsInlined() << " calls to " << inliner.getInlinedSubroutines().size() << " subroutines" << '\n';
+      for (const std::string& subroutine : inliner.getInlinedSubroutines())
+        m_output << "  " << subroutine << '\n';
+    }
+    if (m_options.m_verbosity == Verbosity::NORMAL)
+    {
+      std::size_t numBytesRemoved = 0;
+      for (const CallGraph::RemovedSubroutine& subroutine : removed)
+        numBytesRemoved += subroutine.m_numBytes;
+      m_output << "Removed " << removed.size() << " unreachable subroutines, saving " << numBytesRemoved << " bytes" << '\n';
+      for (const CallGraph::RemovedSubroutine& subroutine : removed)
+        m_output << "  " << subroutine.m_name << " (" << subroutine.m_numBytes << " bytes)" << '\n';
+      m_output << '\n';
+    }
+  }
+
+  void Compiler::writeOutputCodeToConsole(const VmCode& outputCode) const
   {
-    for (std::string codeLine : outputCode)
-      std::cout << codeLine << std::endl;
+    std::string code = outputCode.toText();
+    m_output.write(code.data(), code.size());
+    m_output.flush();
   }
 
-  void Compiler::writeOutputCodeToFile(const std::string& filePath, const std::vector<std::string>& outputCode) const
+  void Compiler::writeOutputCodeToFile(const std::string& filePath, const VmCode& outputCode) const
   {
-    std::ofstream outputFile(filePath);
-    if (outputFile.is_open())
+    //A file already holding exactly this code is left untouched, so that tools going by its modification time see no change
+    VmFileSink vmFileSink(filePath);
+    vmFileSink.writeCode(outputCode);
+    vmFileSink.commit();
+  }
+
+	void Compiler::compileFile(const std::string& filePath)
+	{
+    if (m_options.m_verbosity == Verbosity::NORMAL)
+      m_output << "Compiling file " << filePath << "...\n\n";
+
+    FileTimingScope fileTimingScope(filePath);
+    auto cacheKey = m_context.m_cacheKeys.find(filePath);
+    CachedCompilation compilation;
+    std::unique_ptr<VmFileSink> vmFileSink;
+    if (cacheKey != m_context.m_cacheKeys.end() && findCompilation(cacheKey->second, compilation))
     {
-      for (std::string codeLine : outputCode)
-        outputFile << codeLine << std::endl;
-      
-      outputFile.close();
+      //The class is added to the symbol tables just as the parser would have added it, resolving any uses of it in earlier files
+      reportWarnings(filePath, compilation.m_warnings);
+      if (!compilation.m_interface.m_className.empty())
+      {
+        m_context.m_symbolTables.addSymbolTable(compilation.m_interface.toSymbolTable());
+        Parser::resolveClassSymbols(m_context.m_symbolTables.getSymbolsFromCurrentSymbolTable(), compilation.m_interface.m_className, m_context.m_symbolsToBeResolved);
+      }
     }
     else
-      compilerError("Unable to output code to file '" + filePath + "'");   
+    {
+      //The warnings are collected so they can be stored with the compiled code. The code itself is only held in memory if it is to
+      //be stored, otherwise it is streamed to the vm file a subroutine at a time
+      auto startTime = std::chrono::steady_clock::now();
+      std::size_t diagnosticsStart = m_context.m_diagnostics.size();
+      if (cacheKey == m_context.m_cacheKeys.end())
+        vmFileSink.reset(new VmFileSink(getOutputFilePath(filePath, ".vm")));
+      VmOptimiser optimiser;
+      Parser parser(filePath, m_context.m_symbolTables, m_context.m_symbolsToBeResolved, vmFileSink.get(), m_options.m_optimise ? &optimiser : nullptr, m_options.m_poolStrings);
+      parser.parse();
+      if (vmFileSink)
+        vmFileSink->commit();
+
+      compilation.m_outputCode = parser.getOutputCode();
+      compilation.m_optimisationStatistics = optimiser.getStatistics();
+      compilation.m_optimisationStatistics.merge(parser.getStringPoolStatistics());
+      compilation.m_warnings.assign(m_context.m_diagnostics.begin() + diagnosticsStart, m_context.m_diagnostics.end());
+      getClassInterface(parser, m_context.m_symbolTables, compilation.m_interface);
+      compilation.m_compileMicroseconds = getMicrosecondsSince(startTime);
+      if (cacheKey != m_context.m_cacheKeys.end())
+        m_context.m_compilationsToStore.push_back({cacheKey->second, compilation});
+    }
+
+    if (!vmFileSink)
+      writeOutputCodeToFile(getOutputFilePath(filePath, ".vm"), compilation.m_outputCode);
+    m_context.m_optimisationStatistics.merge(compilation.m_optimisationStatistics);
+    m_context.m_compiledInterfaces.push_back({filePath, compilation.m_interface});
+    m_context.m_compiledWarnings[filePath] = compilation.m_warnings;
+    if (m_options.m_verbosity == Verbosity::NORMAL)
+      m_output << '\n';
+	}
+
+  std::string Compiler::getFileName(const std::string& filePath) const
+  {
+    return filePath.substr(filePath.find_last_of("\\/") + 1);
   }
 
-	void Compiler::compileFile(const std::string& filePath)
-	{
-		std::cout << "Compiling file " << filePath << "..." << std::endl;
-		std::cout << std::endl;
-		Parser parser(filePath, m_symbolTables, m_symbolsToBeResolved);
-		parser.parse();
-    auto outputCode = parser.getOutputCode();
+  bool Compiler::getClassInterface(const Parser& parser, const SymbolTables& symbolTables, ClassInterface& classInterface) const
+  {
+    if (parser.getClassName().empty())
+      return false;
+
+    for (auto symbolTable : symbolTables.getSymbolTables())
+    {
+      if (symbolTable->getTableName() == parser.getClassName())
+      {
+        classInterface = ClassInterface::fromSymbolTable(*symbolTable);
+        classInterface.m_dependencies.assign(parser.getReferencedClasses().begin(), parser.getReferencedClasses().end());
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::string Compiler::getOutputFilePath(const std::string& filePath, const std::string& extension) const
+  {
     //Identify the filename of the filePath string without the file extension
     std::string fileName = filePath.substr(filePath.find_last_of("\\/") + 1, filePath.length());
     fileName = fileName.substr(0, fileName.find_last_of("."));
-    std::string outputFilePath = filePath.substr(0, filePath.find_last_of("\\/") + 1).append(fileName + ".vm");
-    writeOutputCodeToFile(outputFilePath, outputCode);
-		std::cout << std::endl;
-	}
-}
\ No newline at end of file
+    return filePath.substr(0, filePath.find_last_of("\\/") + 1).append(fileName + extension);
+  }
+
+  void Compiler::writeInterfaceFile(const std::string& filePath, const ClassInterface& classInterface) const
+  {
+    ScopedPassTimer passTimer(Pass::OUTPUT);
+    std::string data = classInterface.serialise();
+    if (!writeFileAtomically(filePath, data.data(), data.size()))
+      compilerError("Unable to output interface to file '" + filePath + "'");
+  }
+
+  void Compiler::loadUpToDateInterfaces()
+  {
+    ScopedPassTimer passTimer(Pass::CHANGE_DETECTION);
+    //A file is up to date if its interface was written after the source was last changed and its vm code is still there. The vm
+    //code is only rewritten when it changes, so its own modification time can be older than the source
+    std::vector<std::pair<std::string, ClassInterface>> upToDateFiles;
+    std::vector<std::string> changedFilePaths;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      struct timespec sourceTime, codeTime, interfaceTime;
+      ClassInterface classInterface;
+      if (getModificationTime(filePath, sourceTime) && getModificationTime(getOutputFilePath(filePath, ".vm"), codeTime) && getModificationTime(getOutputFilePath(filePath, ".jif"), interfaceTime) &&
+          isNewerOrSame(interfaceTime, sourceTime) && readInterfaceFile(getOutputFilePath(filePath, ".jif"), classInterface))
+        upToDateFiles.push_back({filePath, classInterface});
+      else
+        changedFilePaths.push_back(filePath);
+    }
+
+    //Only the declarations of the changed files are read here. If they differ from the last build then the code of the classes
+    //using them may have to change too (a function may have become a method, for instance) so those classes are rebuilt as well
+    std::set<std::string> projectClasses;
+    std::set<std::string> changedClasses;
+    for (const std::string& filePath : changedFilePaths)
+    {
+      ClassInterface newInterface = InterfaceScanner(filePath).scan();
+      ClassInterface previousInterface;
+      bool hasPreviousInterface = readInterfaceFile(getOutputFilePath(filePath, ".jif"), previousInterface);
+      if (!hasPreviousInterface || !newInterface.declaresSameMembers(previousInterface))
+      {
+        changedClasses.insert(newInterface.m_className);
+        if (hasPreviousInterface)
+          changedClasses.insert(previousInterface.m_className);
+      }
+      projectClasses.insert(newInterface.m_className);
+    }
+
+    for (auto& upToDateFile : upToDateFiles)
+      projectClasses.insert(upToDateFile.second.m_className);
+
+    std::set<std::string> rebuiltFilePaths(changedFilePaths.begin(), changedFilePaths.end());
+    for (auto& upToDateFile : upToDateFiles)
+    {
+      for (const std::string& dependency : upToDateFile.second.m_dependencies)
+      {
+        //a dependency that no longer exists anywhere is rebuilt so that the error is reported
+        if (changedClasses.count(dependency) || (!projectClasses.count(dependency) && !m_context.m_symbolTables.checkClassDefined(dependency)))
+          rebuiltFilePaths.insert(upToDateFile.first);
+      }
+    }
+
+    //Unchanged classes are checked against from their interfaces instead of being compiled again
+    std::vector<std::string> filePathsToCompile;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      if (rebuiltFilePaths.count(filePath))
+        filePathsToCompile.push_back(filePath);
+    }
+
+    for (auto& upToDateFile : upToDateFiles)
+    {
+      if (!rebuiltFilePaths.count(upToDateFile.first))
+      {
+        m_context.m_symbolTables.addSymbolTable(upToDateFile.second.toSymbolTable());
+        m_context.m_upToDateInterfaces.push_back(upToDateFile.second);
+      }
+    }
+
+    m_context.m_filePaths = filePathsToCompile;
+  }
+
+  void Compiler::scanDeclarations(const std::vector<std::string>& filePaths)
+  {
+    //The memory holds the declarations of the files scanned by earlier builds, as long as they have not changed since
+    std::vector<std::string> filePathsToScan;
+    std::vector<std::uint64_t> sourceHashes;
+    for (const std::string& filePath : filePaths)
+    {
+      std::uint64_t sourceHash = 0;
+      std::string sourceDigest;
+      ClassInterface declarations;
+      if (m_context.m_declarations.count(filePath))
+        continue;
+      if (m_memory && m_memory->getSourceHashes(filePath, sourceHash, sourceDigest) && m_memory->findDeclarations(filePath, sourceHash, declarations))
+        m_context.m_declarations[filePath] = declarations;
+      else
+      {
+        filePathsToScan.push_back(filePath);
+        sourceHashes.push_back(sourceHash);
+      }
+    }
+
+    std::vector<ClassInterface> classInterfaces(filePathsToScan.size());
+    std::vector<char> scanned(filePathsToScan.size(), false);
+    std::vector<PassTimings> scanTimings(m_options.m_timePasses ? filePathsToScan.size() : 0);
+    ThreadPool(m_options.m_numThreads).run(filePathsToScan.size(), [&](std::size_t i)
+    {
+      //A file that cannot be scanned is still compiled, so that the parser reports the error with its usual message
+      std::ostringstream scanDiagnostics;
+      DiagnosticsStreamScope diagnosticsStreamScope(scanDiagnostics);
+      PassTimingsScope passTimingsScope(m_options.m_timePasses ? &scanTimings[i] : nullptr);
+      try
+      {
+        classInterfaces[i] = InterfaceScanner(filePathsToScan[i]).scan();
+        scanned[i] = true;
+      }
+      catch (const CompilationError&)
+      {
+      }
+    });
+
+    for (PassTimings& passTimings : scanTimings)
+      m_context.m_passTimings.merge(passTimings);
+
+    for (std::size_t i = 0; i < filePathsToScan.size(); ++i)
+    {
+      if (!scanned[i])
+        continue;
+      m_context.m_declarations[filePathsToScan[i]] = classInterfaces[i];
+      if (m_memory)
+        m_memory->setDeclarations(filePathsToScan[i], sourceHashes[i], classInterfaces[i]);
+    }
+  }
+
+  void Compiler::orderFilesByDependencies()
+  {
+    ScopedPassTimer passTimer(Pass::ORDERING);
+    DependencyGraph dependencyGraph;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      auto declarations = m_context.m_declarations.find(filePath);
+      if (declarations != m_context.m_declarations.end())
+        dependencyGraph.addClass(declarations->second.m_className, filePath, declarations->second.m_dependencies);
+      else
+        dependencyGraph.addClass("", filePath, {});
+    }
+
+    m_context.m_filePaths.clear();
+    for (const std::vector<std::string>& filePaths : dependencyGraph.getCompileOrder())
+      m_context.m_filePaths.insert(m_context.m_filePaths.end(), filePaths.begin(), filePaths.end());
+  }
+
+  bool Compiler::compileFilesInParallel()
+  {
+    //The index can only stand in for the symbol tables if every class was scanned and no class is declared twice. Anything else
+    //is an error, which is left for the serial compile to report
+    std::vector<ClassInterface> classInterfaces = m_context.m_upToDateInterfaces;
+    std::set<std::string> classNames;
+    for (const ClassInterface& classInterface : classInterfaces)
+      classNames.insert(classInterface.m_className);
+
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      auto declarations = m_context.m_declarations.find(filePath);
+      if (declarations == m_context.m_declarations.end())
+        return false;
+      if (declarations->second.m_className.empty())
+        continue;
+      if (!classNames.insert(declarations->second.m_className).second)
+        return false;
+      classInterfaces.push_back(declarations->second);
+    }
+
+    ProgramIndex programIndex(classInterfaces);
+    std::vector<CompiledFile> compiledFiles(m_context.m_filePaths.size());
+    ThreadPool(m_options.m_numThreads).run(m_context.m_filePaths.size(), [&](std::size_t i)
+    {
+      const std::string& filePath = m_context.m_filePaths[i];
+      CompiledFile& compiledFile = compiledFiles[i];
+      std::ostringstream output;
+      DiagnosticsStreamScope diagnosticsStreamScope(output, &compiledFile.m_diagnostics, m_options.m_verbosity != Verbosity::SILENT);
+      PassTimingsScope passTimingsScope(m_options.m_timePasses ? &compiledFile.m_passTimings : nullptr);
+      auto cacheKey = m_context.m_cacheKeys.find(filePath);
+      if (m_options.m_verbosity == Verbosity::NORMAL)
+        output << "Compiling file " << filePath << "...\n\n";
+      FileTimingScope fileTimingScope(filePath);
+      if (cacheKey != m_context.m_cacheKeys.end() && findCompilation(cacheKey->second, compiledFile.m_compilation))
+      {
+        reportWarnings(filePath, compiledFile.m_compilation.m_warnings);
+        compiledFile.m_succeeded = true;
+      }
+      else
+      {
+        try
+        {
+          //Each file gets its own symbol tables. The other classes are found through the shared index, which leaves out the class
+          //being compiled as the parser declares that itself
+          auto startTime = std::chrono::steady_clock::now();
+          SymbolTables symbolTables;
+          symbolTables.addLibrary(std::make_shared<ProgramIndex>(programIndex, m_context.m_declarations.at(filePath).m_className));
+          for (const auto& library : m_context.m_libraries)
+            symbolTables.addLibrary(library);
+          std::list<SymbolToBeResolved> symbolsToBeResolved;
+
+          VmOptimiser optimiser;
+          Parser parser(filePath, symbolTables, symbolsToBeResolved, nullptr, m_options.m_optimise ? &optimiser : nullptr, m_options.m_poolStrings);
+          parser.parse();
+          compiledFile.m_compilation.m_outputCode = parser.getOutputCode();
+          compiledFile.m_compilation.m_optimisationStatistics = optimiser.getStatistics();
+          compiledFile.m_compilation.m_optimisationStatistics.merge(parser.getStringPoolStatistics());
+          compiledFile.m_compilation.m_warnings = compiledFile.m_diagnostics;
+          getClassInterface(parser, symbolTables, compiledFile.m_compilation.m_interface);
+          compiledFile.m_compilation.m_compileMicroseconds = getMicrosecondsSince(startTime);
+          compiledFile.m_compiled = true;
+          //every class is in the index, so anything still unresolved does not exist
+          compiledFile.m_succeeded = symbolsToBeResolved.empty();
+        }
+        catch (const CompilationError&)
+        {
+        }
+      }
+      compiledFile.m_output = output.str();
+    });
+
+    for (const CompiledFile& compiledFile : compiledFiles)
+    {
+      if (!compiledFile.m_succeeded)
+        return false;
+    }
+
+    for (std::size_t i = 0; i < compiledFiles.size(); ++i)
+    {
+      m_output << compiledFiles[i].m_output;
+      m_context.m_diagnostics.insert(m_context.m_diagnostics.end(), compiledFiles[i].m_diagnostics.begin(), compiledFiles[i].m_diagnostics.end());
+      m_context.m_passTimings.merge(compiledFiles[i].m_passTimings);
+      m_context.m_optimisationStatistics.merge(compiledFiles[i].m_compilation.m_optimisationStatistics);
+      writeOutputCodeToFile(getOutputFilePath(m_context.m_filePaths[i], ".vm"), compiledFiles[i].m_compilation.m_outputCode);
+      m_context.m_compiledInterfaces.push_back({m_context.m_filePaths[i], compiledFiles[i].m_compilation.m_interface});
+      m_context.m_compiledWarnings[m_context.m_filePaths[i]] = compiledFiles[i].m_compilation.m_warnings;
+      auto cacheKey = m_context.m_cacheKeys.find(m_context.m_filePaths[i]);
+      if (compiledFiles[i].m_compiled && cacheKey != m_context.m_cacheKeys.end())
+        m_context.m_compilationsToStore.push_back({cacheKey->second, compiledFiles[i].m_compilation});
+      if (m_options.m_verbosity == Verbosity::NORMAL)
+        m_output << '\n';
+    }
+
+    return true;
+  }
+
+  std::uint64_t Compiler::getEnvironmentKey(const std::vector<std::uint64_t>& libraryHashes) const
+  {
+    //The code generated depends on the compiler itself, so the key changes whenever the compiler binary is rebuilt
+    std::uint64_t environmentKey = hashContent(__DATE__ " " __TIME__, sizeof(__DATE__ " " __TIME__));
+    struct stat status;
+    if (stat("/proc/self/exe", &status) == 0)
+    {
+      std::int64_t executable[3] = {(std::int64_t)status.st_size, (std::int64_t)status.st_mtim.tv_sec, (std::int64_t)status.st_mtim.tv_nsec};
+      environmentKey = hashContent(executable, sizeof(executable), environmentKey);
+    }
+
+    for (std::uint64_t libraryHash : libraryHashes)
+      environmentKey = hashContent(&libraryHash, sizeof(libraryHash), environmentKey);
+
+    //Options changing the code generated for a class give it a different key, so code generated without them is never reused
+    std::uint8_t codeOptions = m_options.m_optimise | m_options.m_poolStrings << 1;
+    environmentKey = hashContent(&codeOptions, sizeof(codeOptions), environmentKey);
+
+    return environmentKey;
+  }
+
+  void Compiler::loadCachedFiles()
+  {
+    ScopedPassTimer passTimer(Pass::CHANGE_DETECTION);
+    m_context.m_manifest.load(m_options.m_directoryPath + "/" + BuildManifest::m_fileName, m_context.m_environmentKey);
+
+    //A file can only be reused if it has the contents it was last compiled from and its vm file is still the one written then
+    std::vector<std::string> candidateFilePaths;
+    std::vector<std::string> changedFilePaths;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      std::uint64_t sourceHash = 0;
+      getSourceHashes(filePath, sourceHash, nullptr);
+      m_context.m_sourceHashes[filePath] = sourceHash;
+
+      const ManifestEntry* entry = m_context.m_manifest.findEntry(getFileName(filePath));
+      struct stat codeStatus;
+      if (entry && entry->m_sourceHash == sourceHash && stat(getOutputFilePath(filePath, ".vm").c_str(), &codeStatus) == 0 && entry->m_codeSize == (std::int64_t)codeStatus.st_size &&
+          entry->m_codeModifiedSeconds == (std::int64_t)codeStatus.st_mtim.tv_sec && entry->m_codeModifiedNanoseconds == (std::int64_t)codeStatus.st_mtim.tv_nsec)
+        candidateFilePaths.push_back(filePath);
+      else
+        changedFilePaths.push_back(filePath);
+    }
+
+    if (candidateFilePaths.empty())
+      return;
+
+    //The declarations of an unchanged file are known from the manifest, the declarations of a changed file have to be scanned.
+    //If a changed file cannot be scanned, or two files declare the same class, everything is compiled so the error is reported
+    scanDeclarations(changedFilePaths);
+    std::map<std::string, std::uint64_t> classHashes;
+    for (const std::string& filePath : candidateFilePaths)
+    {
+      const ClassInterface& classInterface = m_context.m_manifest.findEntry(getFileName(filePath))->m_interface;
+      if (!classInterface.m_className.empty() && !classHashes.insert({classInterface.m_className, classInterface.getDeclarationsHash()}).second)
+        return;
+    }
+
+    for (const std::string& filePath : changedFilePaths)
+    {
+      auto declarations = m_context.m_declarations.find(filePath);
+      if (declarations == m_context.m_declarations.end())
+        return;
+      if (!declarations->second.m_className.empty() && !classHashes.insert({declarations->second.m_className, declarations->second.getDeclarationsHash()}).second)
+        return;
+    }
+
+    //A file's interface only depends on its own contents, so a file that has to be recompiled because a class it uses has changed
+    //does not affect the files using it in turn
+    std::vector<std::string> filePathsToCompile;
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      const ManifestEntry* entry = m_context.m_manifest.findEntry(getFileName(filePath));
+      bool reusable = std::find(candidateFilePaths.begin(), candidateFilePaths.end(), filePath) != candidateFilePaths.end();
+      for (std::size_t i = 0; reusable && i < entry->m_interface.m_dependencies.size(); ++i)
+      {
+        auto classHash = classHashes.find(entry->m_interface.m_dependencies[i]);
+        if ((classHash == classHashes.end() ? 0 : classHash->second) != entry->m_dependencyHashes[i])
+          reusable = false;
+      }
+
+      if (!reusable)
+        filePathsToCompile.push_back(filePath);
+      else
+      {
+        if (!entry->m_interface.m_className.empty())
+        {
+          m_context.m_symbolTables.addSymbolTable(entry->m_interface.toSymbolTable());
+          m_context.m_upToDateInterfaces.push_back(entry->m_interface);
+        }
+        m_context.m_cachedFilePaths.push_back(filePath);
+      }
+    }
+
+    //The warnings of the reused files are reported again, in the order the files would have been compiled in, so that a build
+    //reports the same problems whether or not anything changed
+    DependencyGraph dependencyGraph;
+    for (const std::string& filePath : m_context.m_cachedFilePaths)
+    {
+      const ClassInterface& classInterface = m_context.m_manifest.findEntry(getFileName(filePath))->m_interface;
+      dependencyGraph.addClass(classInterface.m_className, filePath, classInterface.m_dependencies);
+    }
+    for (const std::vector<std::string>& filePaths : dependencyGraph.getCompileOrder())
+    {
+      for (const std::string& filePath : filePaths)
+        reportWarnings(filePath, m_context.m_manifest.findEntry(getFileName(filePath))->m_warnings);
+    }
+
+    m_context.m_filePaths = filePathsToCompile;
+  }
+
+  void Compiler::saveManifest()
+  {
+    ScopedPassTimer passTimer(Pass::OUTPUT);
+    //A no-op build leaves the manifest as it is
+    if (m_context.m_compiledInterfaces.empty() && m_context.m_cachedFilePaths.size() == m_context.m_manifest.getEntries().size())
+      return;
+
+    BuildManifest manifest;
+    std::map<std::string, std::uint64_t> classHashes;
+    for (const std::string& filePath : m_context.m_cachedFilePaths)
+    {
+      const ManifestEntry* entry = m_context.m_manifest.findEntry(getFileName(filePath));
+      manifest.setEntry(getFileName(filePath), *entry);
+      if (!entry->m_interface.m_className.empty())
+        classHashes[entry->m_interface.m_className] = entry->m_interface.getDeclarationsHash();
+    }
+
+    for (auto& compiledInterface : m_context.m_compiledInterfaces)
+    {
+      if (!compiledInterface.second.m_className.empty())
+        classHashes[compiledInterface.second.m_className] = compiledInterface.second.getDeclarationsHash();
+    }
+
+    for (auto& compiledInterface : m_context.m_compiledInterfaces)
+    {
+      ManifestEntry entry;
+      entry.m_sourceHash = m_context.m_sourceHashes[compiledInterface.first];
+      entry.m_interface = compiledInterface.second;
+      entry.m_warnings = m_context.m_compiledWarnings[compiledInterface.first];
+      struct stat codeStatus;
+      if (stat(getOutputFilePath(compiledInterface.first, ".vm").c_str(), &codeStatus) != 0)
+        continue;
+      entry.m_codeSize = codeStatus.st_size;
+      entry.m_codeModifiedSeconds = codeStatus.st_mtim.tv_sec;
+      entry.m_codeModifiedNanoseconds = codeStatus.st_mtim.tv_nsec;
+
+      for (const std::string& dependency : entry.m_interface.m_dependencies)
+      {
+        auto classHash = classHashes.find(dependency);
+        entry.m_dependencyHashes.push_back(classHash == classHashes.end() ? 0 : classHash->second);
+      }
+      manifest.setEntry(getFileName(compiledInterface.first), entry);
+    }
+
+    manifest.save(m_options.m_directoryPath + "/" + BuildManifest::m_fileName, m_context.m_environmentKey);
+  }
+
+  void Compiler::computeCacheKeys()
+  {
+    ScopedPassTimer passTimer(Pass::CACHE);
+    //A dependency that is not a class of the program is a library class, covered by the environment key, or not a class at all.
+    //If two files declare the same class the build will fail, so nothing is looked up
+    std::map<std::string, std::uint64_t> classHashes;
+    for (const ClassInterface& classInterface : m_context.m_upToDateInterfaces)
+      classHashes[classInterface.m_className] = classInterface.getDeclarationsHash();
+
+    for (auto& declarations : m_context.m_declarations)
+    {
+      if (!declarations.second.m_className.empty() && !classHashes.insert({declarations.second.m_className, declarations.second.getDeclarationsHash()}).second)
+        return;
+    }
+
+    //A file that could not be scanned is not given a key, so it is always compiled
+    for (const std::string& filePath : m_context.m_filePaths)
+    {
+      auto declarations = m_context.m_declarations.find(filePath);
+      std::uint64_t sourceHash;
+      std::string sourceDigest;
+      if (declarations == m_context.m_declarations.end() || !getSourceHashes(filePath, sourceHash, &sourceDigest))
+        continue;
+
+      std::vector<std::pair<std::string, std::uint64_t>> dependencyHashes;
+      for (const std::string& dependency : declarations->second.m_dependencies)
+      {
+        auto classHash = classHashes.find(dependency);
+        dependencyHashes.push_back({dependency, classHash == classHashes.end() ? 0 : classHash->second});
+      }
+      m_context.m_cacheKeys[filePath] = CompilationCache::makeKey(m_context.m_environmentKey, sourceDigest, dependencyHashes);
+    }
+  }
+
+  bool Compiler::getSourceHashes(const std::string& filePath, std::uint64_t& sourceHash, std::string* sourceDigest)
+  {
+    std::string memorySourceDigest;
+    if (m_memory)
+    {
+      if (!m_memory->getSourceHashes(filePath, sourceHash, memorySourceDigest))
+        return false;
+      if (sourceDigest)
+        *sourceDigest = memorySourceDigest;
+      return true;
+    }
+
+    std::string source;
+    if (!readFile(filePath, source))
+      return false;
+    sourceHash = hashContent(source.data(), source.size());
+    if (sourceDigest)
+      *sourceDigest = CompilationCache::hashSource(source);
+    return true;
+  }
+
+  bool Compiler::findCompilation(const std::string& key, CachedCompilation& compilation)
+  {
+    ScopedPassTimer passTimer(Pass::CACHE);
+    return (m_memory && m_memory->findCompilation(key, compilation)) || (m_context.m_cache && m_context.m_cache->lookup(key, compilation));
+  }
+
+  void Compiler::printCacheStatistics() const
+  {
+    const CompilationCache& cache = *m_context.m_cache;
+    auto printStatistics = [this](const std::string& title, const CacheStatistics& statistics)
+    {
+      m_output << title << ": " << statistics.m_hits << " hits, " << statistics.m_misses << " misses, " << statistics.m_stores << " stored, " << statistics.m_evictions << " evicted, " <<
+                  statistics.m_savedMicroseconds / 1000 << " ms of compilation saved" << std::endl;
+    };
+
+    printStatistics("Cache statistics for this build", cache.getStatistics());
+    printStatistics("Cache statistics in total", cache.getTotalStatistics());
+    m_output << "Cache size: " << cache.getSize() / 1024 << " KB of " << cache.getMaxSize() / 1024 << " KB" << std::endl;
+  }
+}
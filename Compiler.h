@@ -2,40 +2,281 @@
 
 #include <vector>
 #include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <iostream>
 
 #include "SymbolTable.h"
+#include "ClassInterface.h"
+#include "Library.h"
+#include "Parser.h"
+#include "BuildManifest.h"
+#include "CompilationCache.h"
+#include "BuildMemory.h"
+#include "PassTimer.h"
 
 namespace JackCompiler
 {
+  enum class Verbosity
+  {
+    //only errors are printed
+    SILENT,
+    //errors and warnings are printed, but not the progress of the build
+    QUIET,
+    NORMAL
+  };
+
+  struct CompilerOptions
+  {
+    //The directory of the program being compiled
+    std::string m_directoryPath;
+    //Directories named on the command line or in a program list. Each is a program, or with m_recursive the root of a tree of programs
+    std::vector<std::string> m_rootPaths;
+    //Compile every directory below the roots that contains jack files as a program of its own
+    bool m_recursive = false;
+    //Directories of .jack declaration stubs or binary signature files declaring extra library classes
+    std::vector<std::string> m_libraryPaths;
+    //Write an interface file for each class and only recompile the files that changed since the interfaces were written
+    bool m_useInterfaces = false;
+    //Number of threads used to compile the files - with more than one the files are compiled in parallel against a shared index
+    unsigned m_numThreads = 1;
+    //Keep a manifest of what each file was compiled from and skip the files whose contents and dependencies have not changed
+    bool m_useCache = true;
+    //Directory of the compilation cache shared between builds, or empty if the shared cache is not used
+    std::string m_cacheDirectory;
+    //Size in bytes the shared cache is allowed to grow to before its least recently used entries are evicted
+    std::uint64_t m_cacheMaxSize = 1024ull * 1024 * 1024;
+    //Print the hit and miss counts of the shared cache once the build is finished
+    bool m_printCacheStatistics = false;
+    //Keep running after the build, rebuilding the directory whenever a jack file in it changes
+    bool m_watch = false;
+    Verbosity m_verbosity = Verbosity::NORMAL;
+    //File the errors and warnings of the build are written to as JSON lines, or empty if they are only printed
+    std::string m_diagnosticsPath;
+    //Measure the time taken by each pass of the build and print it once the build is finished
+    bool m_timePasses = false;
+    //File the pass timings are written to as JSON, or empty if they are only printed
+    std::string m_timePassesPath;
+    //Optimise the code of each subroutine once it has been generated
+    bool m_optimise = false;
+    //Build each distinct string literal of a class once, keeping it in a static variable, rather than each time it is used
+    bool m_poolStrings = false;
+    //Leave the subroutines that cannot be called, starting from Main.main and the roots, out of the vm files
+    bool m_wholeProgram = false;
+    //Replace the calls to small subroutines with their code, across the whole program
+    bool m_inline = false;
+    //Subroutines kept along with everything they call, in addition to Main.main and Sys.init
+    std::vector<std::string> m_rootSubroutines;
+    //Print the number of instructions going into and coming out of each optimisation pass once the build is finished
+    bool m_printOptimisationStatistics = false;
+  };
+
+  /**
+  * The libraries named in the options, loaded once and shared by every program compiled in a batch
+  */
+  struct LoadedLibraries
+  {
+    //consulted in this order, ending with the standard library
+    std::vector<std::shared_ptr<const LibraryInterface>> m_libraries;
+    //declaration hashes of the libraries loaded from files, which go into the environment key
+    std::vector<std::uint64_t> m_hashes;
+  };
+
+  /**
+  * The state belonging to a single compilation. Nothing in it is shared with other Compiler objects, so separate compilations
+  * can run at the same time on different threads of one process
+  */
+  struct CompilationContext
+  {
+		std::vector<std::string> m_filePaths;
+    SymbolTables m_symbolTables;
+    //used to store any symbols that need to be resolved at a later date
+    std::list<SymbolToBeResolved> m_symbolsToBeResolved;
+    //interfaces of the compiled files, along with the paths of the files, written out once compilation has succeeded
+    std::vector<std::pair<std::string, ClassInterface>> m_compiledInterfaces;
+    //warnings of the compiled files, keyed by file path, stored in the manifest to be reported again when a file is reused
+    std::map<std::string, std::vector<Diagnostic>> m_compiledWarnings;
+    //libraries consulted by every lookup, in the order they are consulted
+    std::vector<std::shared_ptr<const LibraryInterface>> m_libraries;
+    //interfaces of the classes that are not being compiled again
+    std::vector<ClassInterface> m_upToDateInterfaces;
+    //declarations of each file to compile, keyed by file path. Files that could not be scanned are left out
+    std::map<std::string, ClassInterface> m_declarations;
+    //manifest of the last successful build, along with the files whose code was reused from it in this build
+    BuildManifest m_manifest;
+    std::vector<std::string> m_cachedFilePaths;
+    //hash of the contents of each jack file in the directory
+    std::map<std::string, std::uint64_t> m_sourceHashes;
+    //identifies the compiler and the libraries, as code built by a different compiler or against different libraries cannot be reused
+    std::uint64_t m_environmentKey = 0;
+    //the shared cache, the key of each file to compile that can be cached, and the compilations to store once the build has succeeded
+    std::unique_ptr<CompilationCache> m_cache;
+    std::map<std::string, std::string> m_cacheKeys;
+    std::vector<std::pair<std::string, CachedCompilation>> m_compilationsToStore;
+    //every error and warning reported during the build, in the order they were printed
+    std::vector<Diagnostic> m_diagnostics;
+    //what --time-passes measured, and the time taken by the whole build
+    PassTimings m_passTimings;
+    PassTime m_buildTime;
+    //what the optimisation passes did to the classes compiled or found in a cache
+    OptimisationStatistics m_optimisationStatistics;
+  };
+
+  /**
+  * What a program built as part of a batch passes back to the batch
+  */
+  struct ProgramBuildResult
+  {
+    int m_result = 1;
+    std::vector<Diagnostic> m_diagnostics;
+    PassTimings m_passTimings;
+    PassTime m_buildTime;
+    OptimisationStatistics m_optimisationStatistics;
+  };
+
 	class Compiler
 	{
 	public:
-    Compiler();
     /**
-    * Compiles all the files in the directory entered as a command line argument
+    * Create a compiler that writes its progress messages, errors and warnings to output. A compiler given a memory uses it to skip
+    * reading, scanning and compiling the files that are unchanged since earlier builds made with the same memory
+    */
+    Compiler(std::ostream& output = std::cout, BuildMemory* memory = nullptr) : m_output(output), m_memory(memory) {}
+    /**
+    * Compiles all the files in the directory entered as a command line argument. Returns 0 on success and 1 if a compilation
+    * error was reported
     */
 		int run(int argc, char** argv);
 
 	private:
     /**
+    * Read the options and the directory path from the command line arguments
+    */
+    void parseArguments(int argc, char** argv);
+    /**
     * Compile the jack file found at the filePath
     */
 		void compileFile(const std::string& filePath);
     /**
-    * Creates the symbol tables for all the library subroutines 
+    * Rewrite the vm files of the program with the calls to small subroutines inlined, if the options ask for it, and without the
+    * subroutines that cannot be reached from the roots, reporting what was inlined and removed
     */
-    void addLibrarySymbols();
+    void optimiseWholeProgram();
     /**
     * Print the array of instructions to the console 
     */
-    void writeOutputCodeToConsole(const std::vector<std::string>& outputCode) const;
+    void writeOutputCodeToConsole(const VmCode& outputCode) const;
     /**
     * Write the array of instructions to the text file specified by the filepath
     */
-    void writeOutputCodeToFile(const std::string& filePath, const std::vector<std::string>& outputCode) const;
-		std::vector<std::string> m_filePaths;
-    SymbolTables m_symbolTables;
-    //used to store any symbols that need to be resolved at a later date
-    std::list<SymbolToBeResolved> m_symbolsToBeResolved;
+    void writeOutputCodeToFile(const std::string& filePath, const VmCode& outputCode) const;
+    /**
+    * Return the path of the file produced from the jack file at filePath that has the given extension
+    */
+    std::string getOutputFilePath(const std::string& filePath, const std::string& extension) const;
+    /**
+    * Return the name of the file at filePath without the directory
+    */
+    std::string getFileName(const std::string& filePath) const;
+    void writeInterfaceFile(const std::string& filePath, const ClassInterface& classInterface) const;
+    /**
+    * Add the interfaces of the classes that have not changed since the last build to the symbol tables and remove their files
+    * from the list of files to compile
+    */
+    void loadUpToDateInterfaces();
+    /**
+    * Read the declarations and the referenced names of the given files, that have not already been read, without compiling the
+    * subroutine bodies
+    */
+    void scanDeclarations(const std::vector<std::string>& filePaths);
+    /**
+    * Return the key identifying the compiler binary and the given library images
+    */
+    std::uint64_t getEnvironmentKey(const std::vector<std::uint64_t>& libraryHashes) const;
+    /**
+    * Remove the files that are unchanged since the last build from the list of files to compile, adding their declarations from
+    * the manifest to the symbol tables. A file is unchanged if its contents hash to the value recorded in the manifest, its vm file
+    * has not been touched since it was written and every class it refers to still declares exactly the same members
+    */
+    void loadCachedFiles();
+    /**
+    * Record the files compiled in this build, and the ones reused, in the manifest in the directory
+    */
+    void saveManifest();
+    /**
+    * Work out the shared cache key of each file to compile from its source and the scanned declarations of the classes it uses
+    */
+    void computeCacheKeys();
+    /**
+    * Set the hash of the source at filePath, along with its digest for use in a cache key if sourceDigest is not null. Returns false
+    * if the file cannot be read
+    */
+    bool getSourceHashes(const std::string& filePath, std::uint64_t& sourceHash, std::string* sourceDigest);
+    /**
+    * Look up the compilation with the given cache key in the memory, then in the shared cache. Safe to call from several threads at once
+    */
+    bool findCompilation(const std::string& key, CachedCompilation& compilation);
+    void printCacheStatistics() const;
+    /**
+    * Reorder the files to compile so that each class is compiled after the classes it depends on, using the scanned declarations
+    * and qualified calls of each file. Classes that depend on each other in a cycle are compiled together in name order
+    */
+    void orderFilesByDependencies();
+    /**
+    * Compile the files on several threads against an index of all the scanned declarations. Nothing is written until every file
+    * has compiled, and the progress messages and warnings are then printed in the serial order. Returns false, having written
+    * nothing, if any file fails so that the serial compile can report the error exactly as it always has
+    */
+    bool compileFilesInParallel();
+    /**
+    * Build the interface of the class compiled by the parser from its symbol table, returning false if the file held no class
+    */
+    bool getClassInterface(const Parser& parser, const SymbolTables& symbolTables, ClassInterface& classInterface) const;
+    /**
+    * Compile every file in the directory given in the options
+    */
+    void compileDirectory();
+    /**
+    * Run one build of the directory with the options already read, returning 0 on success and 1 if an error was reported
+    */
+    int build();
+    /**
+    * Load the libraries named in the options, followed by the standard library
+    */
+    LoadedLibraries loadLibraries() const;
+    /**
+    * Return the directories of the programs to compile, found from the roots in the options
+    */
+    std::vector<std::string> findPrograms() const;
+    /**
+    * Compile every program found from the roots, several at a time, printing the output of each program in order along with whether
+    * it compiled. Returns 1 if any program failed
+    */
+    int buildPrograms();
+    /**
+    * Build the single program described by the options, against libraries that have already been loaded
+    */
+    void buildProgram(const CompilerOptions& options, const LoadedLibraries& libraries, ProgramBuildResult& result);
+    /**
+    * Write the diagnostics to the file named in the options as JSON lines, replacing what it held before
+    */
+    void writeDiagnosticsFile(const std::vector<Diagnostic>& diagnostics) const;
+    /**
+    * Print the pass timings, and write them to the file named in the options if there is one
+    */
+    void reportPassTimings(const PassTimings& passTimings, const PassTime& buildTime) const;
+    /**
+    * Build the directory, then rebuild it each time its jack files change. Only the changed files, and the files using a class
+    * whose declarations changed, are compiled again. Returns only if the directory can no longer be watched
+    */
+    int watchDirectory();
+    CompilerOptions m_options;
+    CompilationContext m_context;
+    std::ostream& m_output;
+    //outlives the compiler, and is null unless the compiler is run by a compile server
+    BuildMemory* m_memory;
+    //libraries already loaded by the batch this compiler is building a program of, or null to load them for each build
+    const LoadedLibraries* m_loadedLibraries = nullptr;
 	};
 }
@@ -1,28 +1,229 @@
 #include "Core.h"
+#include "BinaryData.h"
+
+#include <cstdio>
 
 namespace JackCompiler
 {
+  namespace
+  {
+    //the stream errors and warnings are written to on this thread, and the list they are recorded in if any
+    thread_local std::ostream* t_diagnosticsStream = &std::cout;
+    thread_local std::vector<Diagnostic>* t_diagnostics = nullptr;
+    thread_local bool t_printWarnings = true;
+    //where the errors and warnings reported on this thread come from
+    thread_local const std::string* t_filePath = nullptr;
+    thread_local std::function<unsigned(const std::string&)>* t_findColumn = nullptr;
+
+    //The code of a diagnostic is found from the start of its message, the first match winning
+    const std::pair<const char*, const char*> s_diagnosticCodes[] =
+    {
+      {"Expected subroutine to return a value of type", "type-mismatch"},
+      {"Expected return value to be of type", "type-mismatch"},
+      {"Expression in brackets does not evaluate", "type-mismatch"},
+      {"Expression on the right hand side of the assignment", "type-mismatch"},
+      {"Argument list does not match", "type-mismatch"},
+      {"Argument list is not of the correct length", "argument-count"},
+      {"Not all code paths", "missing-return"},
+      {"Expected", "syntax"},
+      {"IDENTIFIER has already been declared", "redeclared-identifier"},
+      {"class with the IDENTIFIER has already been defined", "redeclared-identifier"},
+      {"IDENTIFIER has not been declared", "undeclared-identifier"},
+      {"Symbol has not been resolved", "unresolved-symbol"},
+      {"IDENTIFIER has not been initialised", "uninitialised-variable"},
+      {"Code following this point is unreachable", "unreachable-code"},
+      {"Invalid token", "invalid-token"},
+      {"Integer constant is out of range", "invalid-token"},
+      {"No matching ending comment token", "invalid-token"},
+      {"No terminating", "invalid-token"},
+      {"New line characters are not permitted", "invalid-token"},
+      {"Library", "library"},
+      {"No library", "library"},
+      {"Unable to read library", "library"},
+      {"Subroutine has too many parameters", "library"},
+      {"Unknown option", "usage"},
+      {"No value supplied", "usage"},
+      {"No number of threads", "usage"},
+      {"No library path supplied", "usage"},
+      {"No directory name supplied", "usage"},
+      {"Invalid", "usage"},
+      {"The --", "usage"}
+    };
+
+    std::string getDiagnosticCode(const std::string& message)
+    {
+      for (auto& diagnosticCode : s_diagnosticCodes)
+      {
+        if (message.compare(0, std::char_traits<char>::length(diagnosticCode.first), diagnosticCode.first) == 0)
+          return diagnosticCode.second;
+      }
+      //anything else is a problem with the files or directories being built
+      return "io";
+    }
+
+    Diagnostic makeDiagnostic(Diagnostic::Severity severity, const std::string& message, unsigned lineNum, bool hasLexeme, const std::string& lexeme)
+    {
+      Diagnostic diagnostic;
+      diagnostic.m_severity = severity;
+      diagnostic.m_code = getDiagnosticCode(message);
+      diagnostic.m_message = message;
+      diagnostic.m_filePath = t_filePath ? *t_filePath : "";
+      diagnostic.m_lineNum = lineNum;
+      diagnostic.m_hasLexeme = hasLexeme;
+      diagnostic.m_lexeme = lexeme;
+      if (hasLexeme && t_findColumn)
+        diagnostic.m_column = (*t_findColumn)(lexeme);
+      return diagnostic;
+    }
+
+    void appendJsonString(std::string& json, const std::string& value)
+    {
+      json.push_back('"');
+      for (char character : value)
+      {
+        if (character == '"' || character == '\\')
+          json.append(1, '\\').push_back(character);
+        else if (character == '\n')
+          json.append("\\n");
+        else if (character == '\t')
+          json.append("\\t");
+        else if ((unsigned char)character < 0x20)
+        {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)character);
+          json.append(escaped);
+        }
+        else
+          json.push_back(character);
+      }
+      json.push_back('"');
+    }
+  }
+
+  std::string formatDiagnostic(const Diagnostic& diagnostic)
+  {
+    std::string text = diagnostic.m_severity == Diagnostic::Severity::ERROR ? "COMPILATION ERROR: " : "COMPILATION WARNING: ";
+    if (diagnostic.m_lineNum != 0)
+      text.append("(LINE " + std::to_string(diagnostic.m_lineNum) + ") ");
+    if (diagnostic.m_hasLexeme)
+      text.append("(AT TOKEN '" + diagnostic.m_lexeme + "') ");
+    text.append(diagnostic.m_message);
+    if (diagnostic.m_severity == Diagnostic::Severity::ERROR)
+      text.append(" - ending compilation");
+    return text;
+  }
+
+  std::string formatDiagnosticAsJson(const Diagnostic& diagnostic)
+  {
+    std::string json = "{\"file\":";
+    if (diagnostic.m_filePath.empty())
+      json.append("null");
+    else
+      appendJsonString(json, diagnostic.m_filePath);
+    json.append(",\"line\":" + (diagnostic.m_lineNum != 0 ? std::to_string(diagnostic.m_lineNum) : "null"));
+    json.append(",\"column\":" + (diagnostic.m_column != 0 ? std::to_string(diagnostic.m_column) : "null"));
+    json.append(diagnostic.m_severity == Diagnostic::Severity::ERROR ? ",\"severity\":\"error\"" : ",\"severity\":\"warning\"");
+    json.append(",\"code\":");
+    appendJsonString(json, diagnostic.m_code);
+    json.append(",\"message\":");
+    appendJsonString(json, diagnostic.m_message);
+    json.append(",\"token\":");
+    if (diagnostic.m_hasLexeme)
+      appendJsonString(json, diagnostic.m_lexeme);
+    else
+      json.append("null");
+    json.push_back('}');
+    return json;
+  }
+
+  void serialiseWarnings(std::string& data, const std::vector<Diagnostic>& warnings)
+  {
+    writeValue(data, warnings.size(), 4);
+    for (const Diagnostic& warning : warnings)
+    {
+      writeString(data, warning.m_code);
+      writeString(data, warning.m_message);
+      writeValue(data, warning.m_lineNum, 4);
+      writeValue(data, warning.m_column, 4);
+      writeValue(data, warning.m_hasLexeme, 1);
+      writeString(data, warning.m_lexeme);
+    }
+  }
+
+  void deserialiseWarnings(BinaryReader& reader, std::vector<Diagnostic>& warnings)
+  {
+    for (std::uint64_t i = reader.readValue(4); i > 0 && reader.m_valid; --i)
+    {
+      Diagnostic warning;
+      warning.m_severity = Diagnostic::Severity::WARNING;
+      warning.m_code = reader.readString();
+      warning.m_message = reader.readString();
+      warning.m_lineNum = reader.readValue(4);
+      warning.m_column = reader.readValue(4);
+      warning.m_hasLexeme = reader.readValue(1) != 0;
+      warning.m_lexeme = reader.readString();
+      warnings.push_back(warning);
+    }
+  }
+
+  void reportDiagnostic(const Diagnostic& diagnostic)
+  {
+    //The text is not flushed, so that a build reporting many warnings is not slowed down by writing each one separately
+    if (diagnostic.m_severity == Diagnostic::Severity::ERROR || t_printWarnings)
+      *t_diagnosticsStream << formatDiagnostic(diagnostic) << '\n';
+    if (t_diagnostics)
+      t_diagnostics->push_back(diagnostic);
+  }
+
+  DiagnosticsStreamScope::DiagnosticsStreamScope(std::ostream& stream, std::vector<Diagnostic>* diagnostics, bool printWarnings) :
+    m_previousStream(t_diagnosticsStream), m_previousDiagnostics(t_diagnostics), m_previousPrintWarnings(t_printWarnings)
+  {
+    t_diagnosticsStream = &stream;
+    t_diagnostics = diagnostics;
+    t_printWarnings = printWarnings;
+  }
+
+  DiagnosticsStreamScope::~DiagnosticsStreamScope()
+  {
+    t_diagnosticsStream = m_previousStream;
+    t_diagnostics = m_previousDiagnostics;
+    t_printWarnings = m_previousPrintWarnings;
+  }
+
+  DiagnosticsLocationScope::DiagnosticsLocationScope(const std::string& filePath, std::function<unsigned(const std::string&)> findColumn) :
+    m_previousFilePath(t_filePath), m_previousFindColumn(t_findColumn), m_filePath(filePath), m_findColumn(findColumn)
+  {
+    t_filePath = &m_filePath;
+    t_findColumn = m_findColumn ? &m_findColumn : nullptr;
+  }
+
+  DiagnosticsLocationScope::~DiagnosticsLocationScope()
+  {
+    t_filePath = m_previousFilePath;
+    t_findColumn = m_previousFindColumn;
+  }
+
   void compilerError(const std::string& message)
 	{
-		std::cout << "COMPILATION ERROR: " << message << " - ending compilation" << std::endl;
-		exit(1);
+		reportDiagnostic(makeDiagnostic(Diagnostic::Severity::ERROR, message, 0, false, ""));
+		throw CompilationError(message);
 	}
 
-	void compilerError(const std::string& message, int lineNum)
+	void compilerError(const std::string& message, unsigned lineNum)
 	{
-		std::cout << "COMPILATION ERROR: (LINE " << lineNum << ") " << message << " - ending compilation" << std::endl;
-		exit(1);
+		reportDiagnostic(makeDiagnostic(Diagnostic::Severity::ERROR, message, lineNum, false, ""));
+		throw CompilationError(message);
 	}
 
 	void compilerError(const std::string& message, unsigned lineNum, const std::string& lexeme)
 	{
-		std::cout << "COMPILATION ERROR: (LINE " << lineNum << ") (AT TOKEN '" << lexeme << "') " << message << " - ending compilation" << std::endl;
-		exit(1);
+		reportDiagnostic(makeDiagnostic(Diagnostic::Severity::ERROR, message, lineNum, true, lexeme));
+		throw CompilationError(message);
 	}
 
   void compilerWarning(const std::string& message, unsigned lineNum, const std::string& lexeme)
   {
-    std::cout << "COMPILATION WARNING: (LINE " << lineNum << ") (AT TOKEN '" << lexeme << "') " << message << std::endl;
+    reportDiagnostic(makeDiagnostic(Diagnostic::Severity::WARNING, message, lineNum, true, lexeme));
   }
 
   Token::Token() : m_tokenType(TokenType::NONE), m_lexeme("")
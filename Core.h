@@ -2,9 +2,117 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
 
 namespace JackCompiler
 {
+  struct BinaryReader;
+
+  /**
+  * Thrown by compilerError once the error has been reported, so that a compilation can be abandoned without ending the process
+  */
+  struct CompilationError : public std::runtime_error
+  {
+    CompilationError(const std::string& message) : std::runtime_error(message) {}
+  };
+
+  /**
+  * An error or warning, with everything known about where it was reported
+  */
+  struct Diagnostic
+  {
+    enum class Severity
+    {
+      ERROR,
+      WARNING
+    };
+
+    Severity m_severity = Severity::ERROR;
+    //names the kind of problem, so that tools can pick out particular diagnostics without matching the message
+    std::string m_code;
+    std::string m_message;
+    //the file being compiled when it was reported, or empty if it is not about a jack file
+    std::string m_filePath;
+    //the line and the column of the token it was reported at, or 0 if not known
+    unsigned m_lineNum = 0;
+    unsigned m_column = 0;
+    bool m_hasLexeme = false;
+    std::string m_lexeme;
+  };
+
+  /**
+  * Return the diagnostic as the line of text printed to the console, without the line ending
+  */
+  std::string formatDiagnostic(const Diagnostic& diagnostic);
+  /**
+  * Return the diagnostic as a JSON object on a single line
+  */
+  std::string formatDiagnosticAsJson(const Diagnostic& diagnostic);
+  /**
+  * Append the warnings stored with a compilation to data, leaving out the file, which is known wherever they are read back
+  */
+  void serialiseWarnings(std::string& data, const std::vector<Diagnostic>& warnings);
+  /**
+  * Read warnings written by serialiseWarnings, leaving the reader invalid if they are not well formed
+  */
+  void deserialiseWarnings(BinaryReader& reader, std::vector<Diagnostic>& warnings);
+  /**
+  * Print the diagnostic to the diagnostics stream of the current thread and record it, without throwing for an error. Used to
+  * report the warnings of a compilation again when it is reused
+  */
+  void reportDiagnostic(const Diagnostic& diagnostic);
+
+  /**
+  * Sends the errors and warnings reported on the current thread to the given stream until the object is destroyed, so that
+  * compilations running on different threads can each report to their own stream. Every diagnostic is also added to diagnostics
+  * if it is given, and warnings are only printed if printWarnings is set
+  */
+  class DiagnosticsStreamScope
+  {
+  public:
+    DiagnosticsStreamScope(std::ostream& stream, std::vector<Diagnostic>* diagnostics = nullptr, bool printWarnings = true);
+    ~DiagnosticsStreamScope();
+
+  private:
+    std::ostream* m_previousStream;
+    std::vector<Diagnostic>* m_previousDiagnostics;
+    bool m_previousPrintWarnings;
+  };
+
+  /**
+  * Attributes the errors and warnings reported on the current thread to the file at filePath until the object is destroyed.
+  * findColumn, if given, returns the column of the last token read if it has the given lexeme, or 0
+  */
+  class DiagnosticsLocationScope
+  {
+  public:
+    DiagnosticsLocationScope(const std::string& filePath, std::function<unsigned(const std::string&)> findColumn = nullptr);
+    ~DiagnosticsLocationScope();
+
+  private:
+    const std::string* m_previousFilePath;
+    std::function<unsigned(const std::string&)>* m_previousFindColumn;
+    std::string m_filePath;
+    std::function<unsigned(const std::string&)> m_findColumn;
+  };
+
+  /**
+  * 64 bit FNV-1a hash of a block of bytes. A previous hash can be passed in to combine several blocks into one hash
+  */
+  inline std::uint64_t hashContent(const void* data, std::size_t length, std::uint64_t hash = 14695981039346656037ull)
+  {
+    for (std::size_t i = 0; i < length; ++i)
+    {
+      hash ^= static_cast<const unsigned char*>(data)[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
 	void compilerError(const std::string& message);
 	void compilerError(const std::string& message, unsigned lineNum);
 	void compilerError(const std::string& message, unsigned lineNum, const std::string& lexeme);
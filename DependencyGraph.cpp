@@ -0,0 +1,117 @@
+#include "DependencyGraph.h"
+
+#include <algorithm>
+#include <map>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    //State of Tarjan's strongly connected components algorithm
+    struct ComponentSearch
+    {
+      const std::vector<std::vector<int>>& m_edges;
+      std::vector<int> m_index;
+      std::vector<int> m_lowLink;
+      std::vector<bool> m_onStack;
+      std::vector<int> m_stack;
+      int m_nextIndex;
+      std::vector<std::vector<int>> m_components;
+
+      ComponentSearch(const std::vector<std::vector<int>>& edges) : m_edges(edges), m_index(edges.size(), -1), m_lowLink(edges.size(), 0), m_onStack(edges.size(), false), m_nextIndex(0) {}
+
+      void visit(int node)
+      {
+        m_index[node] = m_lowLink[node] = m_nextIndex++;
+        m_stack.push_back(node);
+        m_onStack[node] = true;
+
+        for (int dependency : m_edges[node])
+        {
+          if (m_index[dependency] == -1)
+          {
+            visit(dependency);
+            m_lowLink[node] = std::min(m_lowLink[node], m_lowLink[dependency]);
+          }
+          else if (m_onStack[dependency])
+            m_lowLink[node] = std::min(m_lowLink[node], m_index[dependency]);
+        }
+
+        //a component is completed after all the components it depends on, so they come out dependencies first
+        if (m_lowLink[node] == m_index[node])
+        {
+          std::vector<int> component;
+          int member;
+          do
+          {
+            member = m_stack.back();
+            m_stack.pop_back();
+            m_onStack[member] = false;
+            component.push_back(member);
+          } while (member != node);
+
+          std::sort(component.begin(), component.end());
+          m_components.push_back(component);
+        }
+      }
+    };
+  }
+
+  void DependencyGraph::addClass(const std::string& className, const std::string& filePath, const std::vector<std::string>& dependencies)
+  {
+    m_classes.push_back({className, filePath, dependencies});
+  }
+
+  std::vector<std::vector<std::string>> DependencyGraph::getCompileOrder() const
+  {
+    //number the classes in name order, so that the compile order is deterministic, and turn the dependency names into edges
+    std::vector<const ClassNode*> classNodes;
+    for (const ClassNode& classNode : m_classes)
+      classNodes.push_back(&classNode);
+    std::sort(classNodes.begin(), classNodes.end(), [](const ClassNode* a, const ClassNode* b)
+    {
+      return a->m_className != b->m_className ? a->m_className < b->m_className : a->m_filePath < b->m_filePath;
+    });
+
+    std::multimap<std::string, int> classNumbers;
+    for (std::size_t i = 0; i < classNodes.size(); ++i)
+    {
+      if (!classNodes[i]->m_className.empty())
+        classNumbers.insert({classNodes[i]->m_className, (int)i});
+    }
+
+    std::vector<std::vector<int>> edges(classNodes.size());
+    for (std::size_t i = 0; i < classNodes.size(); ++i)
+    {
+      for (const std::string& dependency : classNodes[i]->m_dependencies)
+      {
+        auto range = classNumbers.equal_range(dependency);
+        for (auto classNumber = range.first; classNumber != range.second; ++classNumber)
+        {
+          if (classNumber->second != (int)i)
+            edges[i].push_back(classNumber->second);
+        }
+      }
+      std::sort(edges[i].begin(), edges[i].end());
+      edges[i].erase(std::unique(edges[i].begin(), edges[i].end()), edges[i].end());
+    }
+
+    ComponentSearch componentSearch(edges);
+    for (std::size_t i = 0; i < classNodes.size(); ++i)
+    {
+      if (componentSearch.m_index[i] == -1)
+        componentSearch.visit((int)i);
+    }
+
+    std::vector<std::vector<std::string>> compileOrder;
+    for (const std::vector<int>& component : componentSearch.m_components)
+    {
+      std::vector<std::string> filePaths;
+      for (int member : component)
+        filePaths.push_back(classNodes[member]->m_filePath);
+      compileOrder.push_back(filePaths);
+    }
+
+    return compileOrder;
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace JackCompiler
+{
+  /**
+  * The classes of a program and the classes each of them refers to. Used to compile a class only after the classes it depends
+  * on, so that most references can be checked as soon as they are seen instead of being resolved at the end of compilation
+  */
+  class DependencyGraph
+  {
+  public:
+    /**
+    * Add a class, defined in the file at filePath, along with the names it refers to. Names that are not classes of the graph
+    * (library classes, variable names) are ignored. A file whose class could not be read is added with an empty class name
+    */
+    void addClass(const std::string& className, const std::string& filePath, const std::vector<std::string>& dependencies);
+    /**
+    * Return the file paths grouped into strongly connected components. A group only depends on itself and the groups before it,
+    * and the classes of a group depend on each other in a cycle. The order only depends on the class names, never on the order
+    * the classes were added in
+    */
+    std::vector<std::vector<std::string>> getCompileOrder() const;
+
+  private:
+    struct ClassNode
+    {
+      std::string m_className;
+      std::string m_filePath;
+      std::vector<std::string> m_dependencies;
+    };
+
+    //Classes of the graph. The same class may be defined by more than one file, which is reported when the files are compiled
+    std::vector<ClassNode> m_classes;
+  };
+}
@@ -0,0 +1,195 @@
+#include "FileUtilities.h"
+
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    std::string getTemporaryPath(const std::string& filePath)
+    {
+      //the temporary name is unique to the process and thread so that concurrent writers never share a temporary file
+      return filePath + "." + std::to_string(getpid()) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    }
+
+    //the data is handed to the kernel in as few writes as it will take, normally one
+    bool writeAll(int file, const char* data, std::size_t size)
+    {
+      while (size > 0)
+      {
+        ssize_t numBytesWritten = write(file, data, size);
+        if (numBytesWritten < 0 && errno == EINTR)
+          continue;
+        if (numBytesWritten <= 0)
+          return false;
+        data += numBytesWritten;
+        size -= numBytesWritten;
+      }
+      return true;
+    }
+
+    /**
+    * Read up to size bytes, stopping early only at the end of the file, and return the number of bytes read
+    */
+    std::size_t readAll(int file, char* data, std::size_t size)
+    {
+      std::size_t numBytesRead = 0;
+      while (numBytesRead < size)
+      {
+        ssize_t numBytes = read(file, data + numBytesRead, size - numBytesRead);
+        if (numBytes < 0 && errno == EINTR)
+          continue;
+        if (numBytes <= 0)
+          break;
+        numBytesRead += numBytes;
+      }
+      return numBytesRead;
+    }
+
+    /**
+    * Give the temporary file the permissions of the file it replaces, so the rename does not reset them to the default.
+    * The existing file is read through its descriptor when one is open. Nothing is copied when there is no existing file
+    */
+    bool copyFileMode(const std::string& filePath, int existingFile, int temporaryFile)
+    {
+      struct stat existingStatus;
+      int result = existingFile != -1 ? fstat(existingFile, &existingStatus) : stat(filePath.c_str(), &existingStatus);
+      if (result != 0)
+        return existingFile == -1 && errno == ENOENT;
+      return fchmod(temporaryFile, existingStatus.st_mode & 07777) == 0;
+    }
+  }
+
+  bool readFile(const std::string& filePath, std::string& data)
+  {
+    std::ifstream file(filePath, std::ios_base::binary);
+    if (!file.is_open())
+      return false;
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  bool writeFileAtomically(const std::string& filePath, const char* data, std::size_t size)
+  {
+    std::string temporaryPath = getTemporaryPath(filePath);
+    int file = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (file == -1)
+      return false;
+
+    bool written = copyFileMode(filePath, -1, file) && writeAll(file, data, size);
+    if (close(file) != 0 || !written || std::rename(temporaryPath.c_str(), filePath.c_str()) != 0)
+    {
+      std::remove(temporaryPath.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  AtomicFileWriter::AtomicFileWriter(const std::string& filePath) : m_filePath(filePath)
+  {
+    m_existingFile = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+
+  AtomicFileWriter::~AtomicFileWriter()
+  {
+    if (m_existingFile != -1)
+      close(m_existingFile);
+    if (m_temporaryFile != -1)
+      close(m_temporaryFile);
+    if (!m_temporaryPath.empty() && !m_committed)
+      std::remove(m_temporaryPath.c_str());
+  }
+
+  bool AtomicFileWriter::startTemporaryFile()
+  {
+    m_temporaryPath = getTemporaryPath(m_filePath);
+    m_temporaryFile = open(m_temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (m_temporaryFile == -1)
+      return false;
+
+    if (!copyFileMode(m_filePath, m_existingFile, m_temporaryFile))
+      return false;
+
+    std::vector<char> buffer(64 * 1024);
+    for (std::uint64_t offset = 0; offset < m_numMatchingBytes; )
+    {
+      std::size_t numBytes = std::min<std::uint64_t>(buffer.size(), m_numMatchingBytes - offset);
+      ssize_t numBytesRead = pread(m_existingFile, buffer.data(), numBytes, offset);
+      if (numBytesRead < 0 && errno == EINTR)
+        continue;
+      if (numBytesRead <= 0 || !writeAll(m_temporaryFile, buffer.data(), numBytesRead))
+        return false;
+      offset += numBytesRead;
+    }
+
+    if (m_existingFile != -1)
+    {
+      close(m_existingFile);
+      m_existingFile = -1;
+    }
+    return true;
+  }
+
+  bool AtomicFileWriter::write(const char* data, std::size_t size)
+  {
+    if (m_failed)
+      return false;
+
+    if (m_temporaryFile == -1 && m_existingFile != -1)
+    {
+      std::vector<char> existingData(size);
+      if (readAll(m_existingFile, existingData.data(), size) == size && std::equal(existingData.begin(), existingData.end(), data))
+      {
+        m_numMatchingBytes += size;
+        return true;
+      }
+    }
+
+    if ((m_temporaryFile == -1 && !startTemporaryFile()) || !writeAll(m_temporaryFile, data, size))
+      m_failed = true;
+    return !m_failed;
+  }
+
+  bool AtomicFileWriter::commit()
+  {
+    if (m_failed)
+      return false;
+
+    //the new contents are identical if they matched the current file all the way to its end
+    char nextByte;
+    if (m_temporaryFile == -1 && m_existingFile != -1 && readAll(m_existingFile, &nextByte, 1) == 0)
+    {
+      m_committed = true;
+      return true;
+    }
+
+    if (m_temporaryFile == -1 && !startTemporaryFile())
+    {
+      m_failed = true;
+      return false;
+    }
+
+    bool closed = close(m_temporaryFile) == 0;
+    m_temporaryFile = -1;
+    if (!closed || std::rename(m_temporaryPath.c_str(), m_filePath.c_str()) != 0)
+    {
+      m_failed = true;
+      return false;
+    }
+
+    m_committed = true;
+    return true;
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace JackCompiler
+{
+  /**
+  * Read the whole file at filePath into data, returning false if it cannot be opened
+  */
+  bool readFile(const std::string& filePath, std::string& data);
+  /**
+  * Write data to the file at filePath by writing a temporary file next to it and renaming it into place, so that a reader (in
+  * this or another process) never sees a partially written file. Returns false, leaving no temporary file behind, on failure
+  */
+  bool writeFileAtomically(const std::string& filePath, const char* data, std::size_t size);
+
+  /**
+  * Writes a file piece by piece to a temporary file next to it, which takes the place of the file once the writer is committed.
+  * The new contents are compared with the file's current contents as they arrive, and nothing is written at all while they are
+  * identical, so an unchanged file keeps its modification time. A writer destroyed without being committed leaves no trace
+  */
+  class AtomicFileWriter
+  {
+  public:
+    AtomicFileWriter(const std::string& filePath);
+    ~AtomicFileWriter();
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+    /**
+    * Append data to the new contents of the file, returning false if it could not be written
+    */
+    bool write(const char* data, std::size_t size);
+    /**
+    * Put the new contents in place of the file, returning false if they could not be written
+    */
+    bool commit();
+
+  private:
+    /**
+    * Create the temporary file, copying over the start of the current file that the new contents were found to match
+    */
+    bool startTemporaryFile();
+
+    std::string m_filePath;
+    std::string m_temporaryPath;
+    //the current file, read alongside the new contents for as long as they match it
+    int m_existingFile;
+    std::uint64_t m_numMatchingBytes = 0;
+    int m_temporaryFile = -1;
+    bool m_failed = false;
+    bool m_committed = false;
+  };
+}
@@ -0,0 +1,146 @@
+#include "Inliner.h"
+
+#include <algorithm>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    std::string getClassName(const std::string& subroutineName)
+    {
+      return subroutineName.substr(0, subroutineName.find('.'));
+    }
+  }
+
+  void Inliner::addClass(const VmCode& code)
+  {
+    const std::vector<VmInstruction>& instructions = code.getInstructions();
+    for (std::size_t start = 0; start < instructions.size(); ++start)
+    {
+      if (instructions[start].m_opcode != VmOpcode::FUNCTION)
+        continue;
+
+      std::size_t end = start + 1;
+      while (end < instructions.size() && instructions[end].m_opcode != VmOpcode::FUNCTION)
+        ++end;
+
+      const std::string& name = code.getName(instructions[start].m_nameId);
+      Candidate candidate {getClassName(name), false, false, 0, {}, {}};
+      bool canInline = instructions[start].m_operand == 0 && end - start - 2 <= m_maxInstructions && instructions[end - 1].m_opcode == VmOpcode::RETURN;
+      for (std::size_t i = start + 1; i < end - 1 && canInline; ++i)
+      {
+        VmInstruction instruction = instructions[i];
+        //that and pointer 1 hold the inlined subroutine's this, so the subroutine cannot use them for anything else. The only
+        //change to this allowed is a method setting it from its first argument, which leaves constructors out
+        bool setsThisFromArgument = i == start + 2 && instructions[start + 1].m_opcode == VmOpcode::PUSH &&
+                                    instructions[start + 1].m_segment == VmSegment::ARGUMENT && instructions[start + 1].m_operand == 0;
+        if (instruction.m_opcode == VmOpcode::LABEL || instruction.m_opcode == VmOpcode::GOTO || instruction.m_opcode == VmOpcode::IF_GOTO ||
+            instruction.m_opcode == VmOpcode::RETURN || instruction.m_segment == VmSegment::LOCAL || instruction.m_segment == VmSegment::THAT ||
+            (instruction.m_segment == VmSegment::POINTER && instruction.m_operand != 0) ||
+            (instruction.m_opcode == VmOpcode::POP && instruction.m_segment == VmSegment::POINTER && !setsThisFromArgument) ||
+            (instruction.m_opcode == VmOpcode::CALL && code.getName(instruction.m_nameId) == name))
+          canInline = false;
+
+        candidate.m_usesThis = candidate.m_usesThis || instruction.m_segment == VmSegment::THIS || instruction.m_segment == VmSegment::POINTER;
+        candidate.m_usesStatics = candidate.m_usesStatics || instruction.m_segment == VmSegment::STATIC;
+        if (instruction.m_segment == VmSegment::ARGUMENT && instruction.m_operand + 1u > candidate.m_numArgumentsUsed)
+          candidate.m_numArgumentsUsed = instruction.m_operand + 1;
+        if (instruction.m_opcode == VmOpcode::CALL)
+        {
+          instruction.m_nameId = candidate.m_names.size();
+          candidate.m_names.push_back(code.getName(instructions[i].m_nameId));
+        }
+        candidate.m_body.push_back(instruction);
+      }
+
+      if (canInline)
+        m_candidates[name] = std::move(candidate);
+      start = end - 1;
+    }
+  }
+
+  bool Inliner::inlineCalls(VmCode& code)
+  {
+    std::vector<VmInstruction>& instructions = code.getInstructions();
+    std::vector<VmInstruction> inlined;
+    inlined.reserve(instructions.size());
+    std::size_t functionIndex = 0;
+    std::string className;
+    unsigned numLocals = 0;
+    bool changed = false;
+    for (const VmInstruction& instruction : instructions)
+    {
+      if (instruction.m_opcode == VmOpcode::FUNCTION)
+      {
+        functionIndex = inlined.size();
+        className = getClassName(code.getName(instruction.m_nameId));
+        numLocals = instruction.m_operand;
+        inlined.push_back(instruction);
+        continue;
+      }
+
+      auto candidate = instruction.m_opcode == VmOpcode::CALL ? m_candidates.find(code.getName(instruction.m_nameId)) : m_candidates.end();
+      if (candidate == m_candidates.end() || (candidate->second.m_usesStatics && candidate->second.m_className != className) ||
+          candidate->second.m_numArgumentsUsed > instruction.m_operand)
+      {
+        inlined.push_back(instruction);
+        continue;
+      }
+
+      //A single argument read once, straight away, is already where it is needed. Otherwise the arguments are taken off the stack
+      //into local variables added after the caller's own
+      const std::vector<VmInstruction>& body = candidate->second.m_body;
+      unsigned numArguments = instruction.m_operand;
+      bool argumentOnStack = numArguments == 1 && !body.empty() && body.front().m_opcode == VmOpcode::PUSH && body.front().m_segment == VmSegment::ARGUMENT &&
+                             std::count_if(body.begin(), body.end(), [](const VmInstruction& bodyInstruction) { return bodyInstruction.m_segment == VmSegment::ARGUMENT; }) == 1;
+      unsigned numLocalsUsed = numLocals;
+      if (!argumentOnStack)
+      {
+        for (unsigned argument = numArguments; argument > 0; --argument)
+          inlined.push_back({VmOpcode::POP, VmSegment::LOCAL, (std::uint16_t)(numLocals + argument - 1), 0});
+        numLocalsUsed += numArguments;
+      }
+
+      //A call keeps the caller's that, which the caller may be about to store through, so it is kept in another local variable
+      //while the subroutine's this is in its place. The value left on the stack is untouched by the pair of pushes and pops
+      std::uint16_t savedThat = numLocalsUsed;
+      if (candidate->second.m_usesThis)
+      {
+        inlined.push_back({VmOpcode::PUSH, VmSegment::POINTER, 1, 0});
+        inlined.push_back({VmOpcode::POP, VmSegment::LOCAL, savedThat, 0});
+        ++numLocalsUsed;
+      }
+      if (numLocalsUsed > inlined[functionIndex].m_operand)
+        inlined[functionIndex].m_operand = numLocalsUsed;
+
+      for (std::size_t i = argumentOnStack ? 1 : 0; i < body.size(); ++i)
+      {
+        VmInstruction bodyInstruction = body[i];
+        if (bodyInstruction.m_segment == VmSegment::ARGUMENT)
+        {
+          bodyInstruction.m_segment = VmSegment::LOCAL;
+          bodyInstruction.m_operand += numLocals;
+        }
+        else if (bodyInstruction.m_segment == VmSegment::THIS)
+          bodyInstruction.m_segment = VmSegment::THAT;
+        else if (bodyInstruction.m_segment == VmSegment::POINTER)
+          bodyInstruction.m_operand = 1;
+        if (bodyInstruction.m_opcode == VmOpcode::CALL)
+          bodyInstruction.m_nameId = code.internName(candidate->second.m_names[bodyInstruction.m_nameId]);
+        inlined.push_back(bodyInstruction);
+      }
+      if (candidate->second.m_usesThis)
+      {
+        inlined.push_back({VmOpcode::PUSH, VmSegment::LOCAL, savedThat, 0});
+        inlined.push_back({VmOpcode::POP, VmSegment::POINTER, 1, 0});
+      }
+
+      ++m_numCallsInlined;
+      m_inlinedSubroutines.insert(candidate->first);
+      changed = true;
+    }
+
+    instructions.swap(inlined);
+    return changed;
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+#include "VmCode.h"
+
+namespace JackCompiler
+{
+  /**
+  * Replaces the calls to small subroutines of a program with the code of the subroutine. A subroutine is inlined if it has no local
+  * variables, no labels and no return before its last instruction, it does not call itself, it is not a constructor and it is no
+  * longer than the size limit. Its arguments are moved into extra local variables of the caller. A method's this is reached
+  * through that, and the caller's that is kept in one more local variable until the method's code has run, just as a call keeps it
+  */
+  class Inliner
+  {
+  public:
+    Inliner(std::size_t maxInstructions) : m_maxInstructions(maxInstructions) {}
+    /**
+    * Add the subroutines of a class that can be inlined. Every class has to be added before any calls are inlined
+    */
+    void addClass(const VmCode& code);
+    /**
+    * Inline the calls made by the subroutines of the class, returning false if there were none
+    */
+    bool inlineCalls(VmCode& code);
+    std::size_t getNumCallsInlined() const { return m_numCallsInlined; }
+    /**
+    * Returns the names of the subroutines that had at least one of their calls inlined
+    */
+    const std::set<std::string>& getInlinedSubroutines() const { return m_inlinedSubroutines; }
+
+  private:
+    struct Candidate
+    {
+      //the class the subroutine belongs to, which is the only class its static variables can be reached from
+      std::string m_className;
+      //whether the subroutine uses this, which puts it in that in place of the caller's that
+      bool m_usesThis;
+      bool m_usesStatics;
+      //the highest argument used, plus one
+      unsigned m_numArgumentsUsed;
+      //the instructions between the function and the return, with the names they refer to
+      std::vector<VmInstruction> m_body;
+      std::vector<std::string> m_names;
+    };
+
+    std::size_t m_maxInstructions;
+    std::unordered_map<std::string, Candidate> m_candidates;
+    std::size_t m_numCallsInlined = 0;
+    std::set<std::string> m_inlinedSubroutines;
+  };
+}
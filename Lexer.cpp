@@ -1,4 +1,5 @@
 #include "Lexer.h"
+#include "PassTimer.h"
 
 #include <iostream>
 #include <cctype>
@@ -8,6 +9,7 @@ namespace JackCompiler
 {
 	Token Lexer::getNextToken()
 	{
+		ScopedPassTimer passTimer(Pass::LEXING);
 		Token token;
 
 		int currentLineNum = -1;
@@ -15,15 +17,21 @@ namespace JackCompiler
 		//if next token has already been peeked then the m_lineNum will have already been updated so keep it constant
 		if (m_cachedNextToken.m_tokenType != Token::TokenType::NONE)
 			currentLineNum = m_lineNum;
+		else
+			countPassEvents(PassCounter::TOKENS, 1);
 
 		//getting a new token so set the value of cachedNextToken to show it is no longer valid
 		m_cachedNextToken.m_tokenType = Token::TokenType::NONE;
 
 		//Consume the leading whitespace
+		std::streamoff previousTokenPosition = m_tokenPosition;
 		consumeWhiteSpace();
 		//Move file pointer to start of the next token
 		while (consumeComments())
 			consumeWhiteSpace();
+		//a token that was peeked is read again from the same position
+		if (m_tokenPosition != previousTokenPosition)
+			m_previousTokenPosition = previousTokenPosition;
 
 		char nextChar = m_fileStream.peek();
 
@@ -60,6 +68,7 @@ namespace JackCompiler
 		if (m_cachedNextToken.m_tokenType != Token::TokenType::NONE)
 			return m_cachedNextToken;
     
+    ScopedPassTimer passTimer(Pass::LEXING);
     //Call get next token but make sure the file stream reader doesn't progress through the file. 
     //Then cache the peeked token so it can be quickly returned if any consecutive calls to peek are made
 		int currentFilePointer = m_fileStream.tellg();
@@ -69,6 +78,42 @@ namespace JackCompiler
 		return token;
 	}
 
+	unsigned Lexer::findTokenColumn(const std::string& lexeme)
+	{
+		//A diagnostic about a token is often reported once the token after it has been peeked
+		unsigned column = findTokenColumn(m_tokenPosition, lexeme);
+		return column != 0 ? column : findTokenColumn(m_previousTokenPosition, lexeme);
+	}
+
+	unsigned Lexer::findTokenColumn(std::streamoff tokenPosition, const std::string& lexeme)
+	{
+		if (tokenPosition < 0 || lexeme.empty())
+			return 0;
+
+		//Only needed when a diagnostic is reported, so the start of the line is found by reading back over it from the token
+		std::ios_base::iostate state = m_fileStream.rdstate();
+		m_fileStream.clear();
+		std::streampos currentFilePointer = m_fileStream.tellg();
+		std::streamoff start = std::max<std::streamoff>(0, tokenPosition - 4096);
+		std::string text(tokenPosition - start + lexeme.size() + 1, '\0');
+		m_fileStream.seekg(start);
+		m_fileStream.read(&text[0], text.size());
+		text.resize(m_fileStream.gcount());
+		m_fileStream.clear();
+		m_fileStream.seekg(currentFilePointer);
+		m_fileStream.setstate(state);
+
+		//a string constant starts with the quote in front of its lexeme
+		std::size_t tokenStart = tokenPosition - start;
+		if (text.compare(tokenStart, lexeme.size(), lexeme) != 0 && text.compare(tokenStart, lexeme.size() + 1, "\"" + lexeme) != 0)
+			return 0;
+		std::size_t lineEnd = tokenStart == 0 ? std::string::npos : text.rfind('\n', tokenStart - 1);
+		if (lineEnd != std::string::npos)
+			return tokenStart - lineEnd;
+		//a line longer than the text read back has no known column
+		return start == 0 ? tokenStart + 1 : 0;
+	}
+
 	void Lexer::consumeWhiteSpace()
 	{
 		char nextChar = m_fileStream.peek();
@@ -94,6 +139,8 @@ namespace JackCompiler
 	{
 		bool consumedComment = false;
 		int currentFilePointer = m_fileStream.tellg();
+		//the last check for a comment is made at the start of the next token, which saves asking the stream for its position again
+		m_tokenPosition = currentFilePointer;
 
 		//consume line comments
 		char nextChar = m_fileStream.peek();
@@ -24,11 +24,15 @@ namespace JackCompiler
 	class Lexer : public LexerInterface
 	{
 	public:
-		Lexer(const std::string& filePath) : m_lineNum(1), m_fileStream(filePath, std::fstream::in | std::ios_base::binary), m_cachedNextToken() {}
+		Lexer(const std::string& filePath) : m_lineNum(1), m_tokenPosition(-1), m_previousTokenPosition(-1), m_fileStream(filePath, std::fstream::in | std::ios_base::binary), m_cachedNextToken() {}
 		~Lexer() { m_fileStream.close(); }
 		Token getNextToken() override;
 		Token peekNextToken() override;
 		unsigned getLineNum() const { return m_lineNum; }
+    /**
+    * Return the column, counting from 1, of the last or the second last token read that has the given lexeme, or 0 if neither has
+    */
+    unsigned findTokenColumn(const std::string& lexeme);
 
 	private:
 		void consumeWhiteSpace();
@@ -39,7 +43,11 @@ namespace JackCompiler
 		bool checkIntegerConstant(Token& token);
 		bool checkStringConstant(Token& token);
 		bool checkSymbol(Token& token);
+		unsigned findTokenColumn(std::streamoff tokenPosition, const std::string& lexeme);
 		unsigned m_lineNum;
+		//the positions in the file of the last and the second last token read
+		std::streamoff m_tokenPosition;
+		std::streamoff m_previousTokenPosition;
 		std::fstream m_fileStream;
 		//cache the next token when calling peek to improve 
 		//performance if multiple peek calls are made successively
@@ -0,0 +1,190 @@
+#include "Library.h"
+
+namespace JackCompiler
+{
+  namespace
+  {
+    struct LibrarySymbol
+    {
+      const char* m_name;
+      Symbol::SymbolKind m_kind;
+      const char* m_type;
+      //unused parameter slots are left as nullptr
+      const char* m_parameterList[4];
+    };
+
+    constexpr LibrarySymbol s_librarySymbols[] =
+    {
+      //Math class subroutines
+      {"Math", Symbol::SymbolKind::CLASS, "", {}},
+      {"Math.abs", Symbol::SymbolKind::FUNCTION, "int", {"int"}},
+      {"Math.multiply", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"}},
+      {"Math.divide", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"}},
+      {"Math.min", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"}},
+      {"Math.max", Symbol::SymbolKind::FUNCTION, "int", {"int", "int"}},
+      {"Math.sqrt", Symbol::SymbolKind::FUNCTION, "int", {"int"}},
+
+      //Array class subroutines
+      {"Array", Symbol::SymbolKind::CLASS, "", {}},
+      {"Array.new", Symbol::SymbolKind::FUNCTION, "Array", {"int"}},
+      {"Array.dispose", Symbol::SymbolKind::METHOD, "void", {}},
+
+      //Memory class subroutines
+      {"Memory", Symbol::SymbolKind::CLASS, "", {}},
+      {"Memory.peek", Symbol::SymbolKind::FUNCTION, "int", {"int"}},
+      {"Memory.poke", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"}},
+      {"Memory.alloc", Symbol::SymbolKind::FUNCTION, "Array", {"int"}},
+      {"Memory.deAlloc", Symbol::SymbolKind::FUNCTION, "void", {"any"}},
+
+      //Screen class subroutines
+      {"Screen", Symbol::SymbolKind::CLASS, "", {}},
+      {"Screen.clearScreen", Symbol::SymbolKind::FUNCTION, "void", {}},
+      {"Screen.setColor", Symbol::SymbolKind::FUNCTION, "void", {"boolean"}},
+      {"Screen.drawPixel", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"}},
+      {"Screen.drawLine", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int", "int"}},
+      {"Screen.drawRectangle", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int", "int"}},
+      {"Screen.drawCircle", Symbol::SymbolKind::FUNCTION, "void", {"int", "int", "int"}},
+
+      //Keyboard class subroutines
+      {"Keyboard", Symbol::SymbolKind::CLASS, "", {}},
+      {"Keyboard.keyPressed", Symbol::SymbolKind::FUNCTION, "char", {}},
+      {"Keyboard.readChar", Symbol::SymbolKind::FUNCTION, "char", {}},
+      {"Keyboard.readLine", Symbol::SymbolKind::FUNCTION, "String", {"String"}},
+      {"Keyboard.readInt", Symbol::SymbolKind::FUNCTION, "int", {"String"}},
+
+      //Output class subroutines
+      {"Output", Symbol::SymbolKind::CLASS, "", {}},
+      {"Output.init", Symbol::SymbolKind::FUNCTION, "void", {}},
+      {"Output.moveCursor", Symbol::SymbolKind::FUNCTION, "void", {"int", "int"}},
+      {"Output.printChar", Symbol::SymbolKind::FUNCTION, "void", {"char"}},
+      {"Output.printString", Symbol::SymbolKind::FUNCTION, "void", {"String"}},
+      {"Output.printInt", Symbol::SymbolKind::FUNCTION, "void", {"int"}},
+      {"Output.printLn", Symbol::SymbolKind::FUNCTION, "void", {}},
+      {"Output.backSpace", Symbol::SymbolKind::FUNCTION, "void", {}},
+
+      //String class subroutines
+      {"String", Symbol::SymbolKind::CLASS, "", {}},
+      {"String.new", Symbol::SymbolKind::CONSTRUCTOR, "String", {"int"}},
+      {"String.dispose", Symbol::SymbolKind::METHOD, "void", {}},
+      {"String.length", Symbol::SymbolKind::METHOD, "int", {}},
+      {"String.charAt", Symbol::SymbolKind::METHOD, "char", {"int"}},
+      {"String.setCharAt", Symbol::SymbolKind::METHOD, "void", {"int", "char"}},
+      {"String.appendChar", Symbol::SymbolKind::METHOD, "String", {"char"}},
+      {"String.eraseLastChar", Symbol::SymbolKind::METHOD, "void", {}},
+      {"String.intValue", Symbol::SymbolKind::METHOD, "int", {}},
+      {"String.setInt", Symbol::SymbolKind::METHOD, "void", {"int"}},
+      {"String.newLine", Symbol::SymbolKind::FUNCTION, "char", {}},
+      {"String.backSpace", Symbol::SymbolKind::FUNCTION, "char", {}},
+      {"String.doubleQuote", Symbol::SymbolKind::FUNCTION, "char", {}},
+
+      //Sys class subroutines
+      {"Sys", Symbol::SymbolKind::CLASS, "", {}},
+      {"Sys.halt", Symbol::SymbolKind::FUNCTION, "void", {}},
+      {"Sys.error", Symbol::SymbolKind::FUNCTION, "void", {"int"}},
+      {"Sys.wait", Symbol::SymbolKind::FUNCTION, "void", {"int"}}
+    };
+
+    constexpr unsigned s_numLibrarySymbols = sizeof(s_librarySymbols) / sizeof(s_librarySymbols[0]);
+    //Must be a power of two so the slot can be found with a mask rather than a division
+    constexpr unsigned s_hashTableSize = 256;
+
+    struct PerfectHashTable
+    {
+      bool m_valid;
+      std::uint32_t m_seed;
+      //stores the index into s_librarySymbols plus one, so that 0 marks an empty slot
+      std::uint8_t m_slots[s_hashTableSize];
+    };
+
+    constexpr PerfectHashTable buildPerfectHashTable()
+    {
+      for (std::uint32_t seed = 0; seed < 100000; ++seed)
+      {
+        PerfectHashTable table {false, seed, {}};
+        bool collision = false;
+        for (unsigned i = 0; i < s_numLibrarySymbols && !collision; ++i)
+        {
+          unsigned slot = hashLibraryName(s_librarySymbols[i].m_name, nameLength(s_librarySymbols[i].m_name), seed) & (s_hashTableSize - 1);
+          if (table.m_slots[slot] != 0)
+            collision = true;
+          else
+            table.m_slots[slot] = i + 1;
+        }
+
+        if (!collision)
+        {
+          table.m_valid = true;
+          return table;
+        }
+      }
+
+      return PerfectHashTable {false, 0, {}};
+    }
+
+    constexpr PerfectHashTable s_perfectHashTable = buildPerfectHashTable();
+    static_assert(s_perfectHashTable.m_valid, "No perfect hash seed found for the library symbol table - increase s_hashTableSize");
+    static_assert(s_numLibrarySymbols < 255, "Library symbol indexes must fit in a hash table slot");
+
+    unsigned countParameters(const LibrarySymbol& symbol)
+    {
+      unsigned numParameters = 0;
+      while (numParameters < 4 && symbol.m_parameterList[numParameters])
+        ++numParameters;
+      return numParameters;
+    }
+  }
+
+  int StandardLibrary::findSymbol(const std::string& name) const
+  {
+    unsigned slot = hashLibraryName(name.data(), name.length(), s_perfectHashTable.m_seed) & (s_hashTableSize - 1);
+    int index = (int)s_perfectHashTable.m_slots[slot] - 1;
+    //the slot may be occupied by a different library name that happens to hash to the same place
+    if (index == -1 || name != s_librarySymbols[index].m_name)
+      return -1;
+
+    return index;
+  }
+
+  bool StandardLibrary::checkClassDefined(const std::string& className) const
+  {
+    int index = findSymbol(className);
+    return index != -1 && s_librarySymbols[index].m_kind == Symbol::SymbolKind::CLASS;
+  }
+
+  bool StandardLibrary::checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const
+  {
+    //the library only declares subroutines, so variables of any kind can never match
+    if (symbolKind == Symbol::SymbolKind::ARGUMENT || symbolKind == Symbol::SymbolKind::VAR || symbolKind == Symbol::SymbolKind::FIELD || symbolKind == Symbol::SymbolKind::STATIC)
+      return false;
+
+    int index = findSymbol(name);
+    return index != -1 && isSubroutineKind(s_librarySymbols[index].m_kind);
+  }
+
+  std::pair<bool, std::string> StandardLibrary::getSymbolType(const std::string& name) const
+  {
+    int index = findSymbol(name);
+    if (index == -1 || !isSubroutineKind(s_librarySymbols[index].m_kind))
+      return std::pair<bool, std::string>{false, "NO SUCH SYMBOL"};
+
+    return std::pair<bool, std::string>{true, s_librarySymbols[index].m_type};
+  }
+
+  const std::vector<std::string>* StandardLibrary::getParameterList(const std::string& subroutineSymbolName) const
+  {
+    int index = findSymbol(subroutineSymbolName);
+    if (index == -1 || !isSubroutineKind(s_librarySymbols[index].m_kind))
+      return nullptr;
+
+    //The rest of the compiler works with parameter lists as vectors, so build them once on first use rather than at startup
+    static const std::vector<std::vector<std::string>> parameterLists = []()
+    {
+      std::vector<std::vector<std::string>> lists(s_numLibrarySymbols);
+      for (unsigned i = 0; i < s_numLibrarySymbols; ++i)
+        lists[i].assign(s_librarySymbols[i].m_parameterList, s_librarySymbols[i].m_parameterList + countParameters(s_librarySymbols[i]));
+      return lists;
+    }();
+
+    return &parameterLists[index];
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#include "SymbolTable.h"
+
+namespace JackCompiler
+{
+  constexpr std::size_t nameLength(const char* name)
+  {
+    std::size_t length = 0;
+    while (name[length] != '\0')
+      ++length;
+    return length;
+  }
+
+  /**
+  * FNV-1a hash mixed with a seed, used to place library names in hash tables. Usable at compile time so that the standard library table can be built by the compiler
+  */
+  constexpr std::uint32_t hashLibraryName(const char* name, std::size_t length, std::uint32_t seed)
+  {
+    std::uint32_t hash = 2166136261u ^ (seed * 16777619u);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+      hash ^= (unsigned char)name[i];
+      hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+  }
+
+  inline bool isSubroutineKind(const Symbol::SymbolKind& symbolKind)
+  {
+    return symbolKind == Symbol::SymbolKind::FUNCTION || symbolKind == Symbol::SymbolKind::METHOD || symbolKind == Symbol::SymbolKind::CONSTRUCTOR;
+  }
+
+  class LibraryInterface
+  {
+  public:
+    virtual ~LibraryInterface() {}
+    /**
+    * Returns a boolean indicating whether the library declares a class with the given name
+    */
+    virtual bool checkClassDefined(const std::string& className) const = 0;
+    /**
+    * Check if a certain symbol (of the form className.symbolName) is declared by the library
+    */
+    virtual bool checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const = 0;
+    /**
+    * Given the name of a symbol return the type of the symbol along with a boolean indicating whether the symbol was found
+    */
+    virtual std::pair<bool, std::string> getSymbolType(const std::string& name) const = 0;
+    /**
+    * Return the parameter list of a subroutine symbol, or nullptr if the library does not declare it
+    */
+    virtual const std::vector<std::string>* getParameterList(const std::string& subroutineSymbolName) const = 0;
+  };
+
+  /**
+  * The Jack OS API (Math, Array, Memory, Screen, Keyboard, Output, String and Sys). The declarations are held in a constexpr table
+  * compiled into the binary and found through a perfect hash, so no symbol tables are built for them at startup
+  */
+  class StandardLibrary : public LibraryInterface
+  {
+  public:
+    bool checkClassDefined(const std::string& className) const override;
+    bool checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const override;
+    std::pair<bool, std::string> getSymbolType(const std::string& name) const override;
+    const std::vector<std::string>* getParameterList(const std::string& subroutineSymbolName) const override;
+
+  private:
+    /**
+    * Return the index of the named entry in the library table, or -1 if the library does not declare it
+    */
+    int findSymbol(const std::string& name) const;
+  };
+}
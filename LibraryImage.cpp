@@ -0,0 +1,383 @@
+#include "LibraryImage.h"
+#include "FileUtilities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char s_magic[4] = {'J', 'L', 'I', 'B'};
+    const std::uint32_t s_formatVersion = 1;
+
+    /*
+      Layout of a signature file: the header, the entries, the hash table of entry indexes (plus one, 0 marks an empty slot),
+      the parameter type list of every subroutine as string offsets and finally the null terminated strings themselves
+    */
+    struct ImageHeader
+    {
+      char m_magic[4];
+      std::uint32_t m_version;
+      std::uint64_t m_fingerprint;
+      std::uint32_t m_numEntries;
+      std::uint32_t m_hashTableSize;
+      std::uint32_t m_entriesOffset;
+      std::uint32_t m_hashTableOffset;
+      std::uint32_t m_parametersOffset;
+      std::uint32_t m_numParameters;
+      std::uint32_t m_stringsOffset;
+      std::uint32_t m_stringsSize;
+    };
+
+    struct ImageEntry
+    {
+      std::uint32_t m_nameOffset;
+      std::uint32_t m_typeOffset;
+      std::uint32_t m_firstParameter;
+      std::uint8_t m_kind;
+      std::uint8_t m_numParameters;
+      std::uint16_t m_reserved;
+    };
+
+    const ImageHeader& header(const char* data)
+    {
+      return *reinterpret_cast<const ImageHeader*>(data);
+    }
+
+    const ImageEntry* entries(const char* data)
+    {
+      return reinterpret_cast<const ImageEntry*>(data + header(data).m_entriesOffset);
+    }
+
+    const std::uint32_t* hashTable(const char* data)
+    {
+      return reinterpret_cast<const std::uint32_t*>(data + header(data).m_hashTableOffset);
+    }
+
+    const std::uint32_t* parameters(const char* data)
+    {
+      return reinterpret_cast<const std::uint32_t*>(data + header(data).m_parametersOffset);
+    }
+
+    const char* string(const char* data, std::uint32_t offset)
+    {
+      return data + header(data).m_stringsOffset + offset;
+    }
+
+    /**
+    * Fingerprint the stubs in a directory from their names, sizes and modification times, so that a cached image can be
+    * checked without reading any of them
+    */
+    std::uint64_t fingerprintDirectory(const std::string& directoryPath, std::vector<std::string>& stubPaths)
+    {
+      DIR* directory = opendir(directoryPath.c_str());
+      if (directory == NULL)
+        compilerError("No library directory exists with the name \"" + directoryPath + "\"");
+
+      std::vector<std::string> stubNames;
+      for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+      {
+        std::string fileName = entry->d_name;
+        if (fileName.size() > 5 && fileName.substr(fileName.size() - 5) == ".jack")
+          stubNames.push_back(fileName);
+      }
+      closedir(directory);
+      std::sort(stubNames.begin(), stubNames.end());
+
+      std::uint64_t fingerprint = 14695981039346656037ull ^ s_formatVersion;
+      auto mix = [&fingerprint](const void* bytes, std::size_t length)
+      {
+        fingerprint = hashContent(bytes, length, fingerprint);
+      };
+
+      for (const std::string& stubName : stubNames)
+      {
+        std::string stubPath = directoryPath + "/" + stubName;
+        struct stat status;
+        if (stat(stubPath.c_str(), &status) != 0)
+          continue;
+
+        std::int64_t modified[3] = {(std::int64_t)status.st_size, (std::int64_t)status.st_mtim.tv_sec, (std::int64_t)status.st_mtim.tv_nsec};
+        mix(stubName.c_str(), stubName.size() + 1);
+        mix(modified, sizeof(modified));
+        stubPaths.push_back(stubPath);
+      }
+
+      return fingerprint;
+    }
+  }
+
+  const std::string LibraryImage::m_cacheFileName = ".library.jlib";
+
+  LibraryImage::LibraryImage(const std::string& path, std::vector<char>&& data) : m_path(path), m_ownedData(std::move(data)), m_mapping(nullptr)
+  {
+    m_data = m_ownedData.data();
+    m_size = m_ownedData.size();
+  }
+
+  LibraryImage::LibraryImage(const std::string& path, void* mapping, std::size_t size) : m_path(path), m_mapping(mapping), m_data(static_cast<const char*>(mapping)), m_size(size) {}
+
+  LibraryImage::~LibraryImage()
+  {
+    if (m_mapping)
+      munmap(m_mapping, m_size);
+  }
+
+  std::shared_ptr<LibraryImage> LibraryImage::mapFile(const std::string& path)
+  {
+    int fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor == -1)
+      return nullptr;
+
+    struct stat status;
+    void* mapping = MAP_FAILED;
+    if (fstat(fileDescriptor, &status) == 0 && status.st_size > 0)
+      mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+
+    if (mapping == MAP_FAILED)
+      return nullptr;
+
+    return std::shared_ptr<LibraryImage>(new LibraryImage(path, mapping, status.st_size));
+  }
+
+  std::shared_ptr<LibraryImage> LibraryImage::load(const std::string& path)
+  {
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+      compilerError("No library exists with the name \"" + path + "\"");
+
+    //A single file must already be a binary signature file
+    if (!S_ISDIR(status.st_mode))
+    {
+      std::shared_ptr<LibraryImage> library = mapFile(path);
+      if (!library)
+        compilerError("Unable to read library signature file '" + path + "'");
+      if (!library->isValid())
+        compilerError("Library signature file is corrupt or was written by a different version of the compiler : " + path);
+      return library;
+    }
+
+    std::vector<std::string> stubPaths;
+    std::uint64_t fingerprint = fingerprintDirectory(path, stubPaths);
+    std::string cachePath = path + "/" + m_cacheFileName;
+
+    //Use the cached image if it was built from exactly the stubs that are in the directory now. A cache that cannot be used is
+    //simply rebuilt
+    std::shared_ptr<LibraryImage> cachedLibrary = mapFile(cachePath);
+    if (cachedLibrary && cachedLibrary->isValid() && cachedLibrary->getFingerprint() == fingerprint)
+      return cachedLibrary;
+
+    std::vector<ClassInterface> classInterfaces;
+    for (const std::string& stubPath : stubPaths)
+    {
+      ClassInterface classInterface = InterfaceScanner(stubPath).scan();
+      if (!classInterface.m_className.empty())
+        classInterfaces.push_back(classInterface);
+    }
+
+    std::vector<char> image = buildImage(classInterfaces, fingerprint);
+
+    //Write the image to a temporary file first so a concurrent build (in this or another process) never maps a partially written cache. Failing to write the
+    //cache (for instance in a read-only directory) is not an error, the stubs will just be scanned again next time
+    writeFileAtomically(cachePath, image.data(), image.size());
+
+    return std::shared_ptr<LibraryImage>(new LibraryImage(path, std::move(image)));
+  }
+
+  std::vector<char> LibraryImage::buildImage(const std::vector<ClassInterface>& classInterfaces, std::uint64_t fingerprint)
+  {
+    std::vector<ImageEntry> imageEntries;
+    std::vector<std::uint32_t> imageParameters;
+    std::string strings;
+    std::unordered_map<std::string, std::uint32_t> stringOffsets;
+    std::vector<std::string> names;
+
+    //Type names are repeated many times across a library so every string is only stored once
+    auto addString = [&](const std::string& value)
+    {
+      auto existing = stringOffsets.find(value);
+      if (existing != stringOffsets.end())
+        return existing->second;
+
+      std::uint32_t offset = strings.size();
+      strings.append(value).push_back('\0');
+      stringOffsets[value] = offset;
+      return offset;
+    };
+
+    for (const ClassInterface& classInterface : classInterfaces)
+    {
+      imageEntries.push_back({addString(classInterface.m_className), addString(""), 0, (std::uint8_t)Symbol::SymbolKind::CLASS, 0, 0});
+      names.push_back(classInterface.m_className);
+
+      for (const SubroutineDeclaration& subroutine : classInterface.m_subroutines)
+      {
+        std::string name = classInterface.m_className + "." + subroutine.m_name;
+        ImageEntry entry {addString(name), addString(subroutine.m_returnType), (std::uint32_t)imageParameters.size(), (std::uint8_t)subroutine.m_kind, (std::uint8_t)subroutine.m_parameterTypes.size(), 0};
+        if (subroutine.m_parameterTypes.size() > 255)
+          compilerError("Subroutine has too many parameters to be stored in a library : " + name);
+
+        for (const std::string& parameterType : subroutine.m_parameterTypes)
+          imageParameters.push_back(addString(parameterType));
+
+        imageEntries.push_back(entry);
+        names.push_back(name);
+      }
+    }
+
+    //Size the hash table so that it is never more than half full, which keeps the linear probe sequences short
+    std::uint32_t hashTableSize = 8;
+    while (hashTableSize < imageEntries.size() * 2)
+      hashTableSize *= 2;
+
+    std::vector<std::uint32_t> imageHashTable(hashTableSize, 0);
+    for (std::uint32_t i = 0; i < names.size(); ++i)
+    {
+      std::uint32_t slot = hashLibraryName(names[i].data(), names[i].size(), 0) & (hashTableSize - 1);
+      while (imageHashTable[slot] != 0)
+      {
+        if (names[imageHashTable[slot] - 1] == names[i])
+          compilerError("Library declares the same symbol more than once : " + names[i]);
+        slot = (slot + 1) & (hashTableSize - 1);
+      }
+      imageHashTable[slot] = i + 1;
+    }
+
+    ImageHeader imageHeader;
+    std::memcpy(imageHeader.m_magic, s_magic, sizeof(s_magic));
+    imageHeader.m_version = s_formatVersion;
+    imageHeader.m_fingerprint = fingerprint;
+    imageHeader.m_numEntries = imageEntries.size();
+    imageHeader.m_hashTableSize = hashTableSize;
+    imageHeader.m_entriesOffset = sizeof(ImageHeader);
+    imageHeader.m_hashTableOffset = imageHeader.m_entriesOffset + imageEntries.size() * sizeof(ImageEntry);
+    imageHeader.m_parametersOffset = imageHeader.m_hashTableOffset + hashTableSize * sizeof(std::uint32_t);
+    imageHeader.m_numParameters = imageParameters.size();
+    imageHeader.m_stringsOffset = imageHeader.m_parametersOffset + imageParameters.size() * sizeof(std::uint32_t);
+    imageHeader.m_stringsSize = strings.size();
+
+    std::vector<char> image(imageHeader.m_stringsOffset + strings.size());
+    std::memcpy(image.data(), &imageHeader, sizeof(imageHeader));
+    std::memcpy(image.data() + imageHeader.m_entriesOffset, imageEntries.data(), imageEntries.size() * sizeof(ImageEntry));
+    std::memcpy(image.data() + imageHeader.m_hashTableOffset, imageHashTable.data(), hashTableSize * sizeof(std::uint32_t));
+    std::memcpy(image.data() + imageHeader.m_parametersOffset, imageParameters.data(), imageParameters.size() * sizeof(std::uint32_t));
+    std::memcpy(image.data() + imageHeader.m_stringsOffset, strings.data(), strings.size());
+    return image;
+  }
+
+  bool LibraryImage::isValid() const
+  {
+    if (m_size < sizeof(ImageHeader) || std::memcmp(header(m_data).m_magic, s_magic, sizeof(s_magic)) != 0 || header(m_data).m_version != s_formatVersion)
+      return false;
+
+    const ImageHeader& imageHeader = header(m_data);
+    std::uint64_t hashTableSize = imageHeader.m_hashTableSize;
+    if (hashTableSize == 0 || (hashTableSize & (hashTableSize - 1)) != 0 || imageHeader.m_numEntries >= hashTableSize ||
+        imageHeader.m_entriesOffset != sizeof(ImageHeader) ||
+        imageHeader.m_hashTableOffset != imageHeader.m_entriesOffset + (std::uint64_t)imageHeader.m_numEntries * sizeof(ImageEntry) ||
+        imageHeader.m_parametersOffset != imageHeader.m_hashTableOffset + hashTableSize * sizeof(std::uint32_t) ||
+        imageHeader.m_stringsOffset != imageHeader.m_parametersOffset + (std::uint64_t)imageHeader.m_numParameters * sizeof(std::uint32_t) ||
+        (std::uint64_t)imageHeader.m_stringsOffset + imageHeader.m_stringsSize != m_size ||
+        imageHeader.m_stringsSize == 0 || m_data[m_size - 1] != '\0')
+      return false;
+
+    for (std::uint32_t i = 0; i < hashTableSize; ++i)
+    {
+      if (hashTable(m_data)[i] > imageHeader.m_numEntries)
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < imageHeader.m_numParameters; ++i)
+    {
+      if (parameters(m_data)[i] >= imageHeader.m_stringsSize)
+        return false;
+    }
+
+    for (std::uint32_t i = 0; i < imageHeader.m_numEntries; ++i)
+    {
+      const ImageEntry& entry = entries(m_data)[i];
+      if (entry.m_nameOffset >= imageHeader.m_stringsSize || entry.m_typeOffset >= imageHeader.m_stringsSize || entry.m_kind > (std::uint8_t)Symbol::SymbolKind::CLASS ||
+          (std::uint64_t)entry.m_firstParameter + entry.m_numParameters > imageHeader.m_numParameters)
+        return false;
+    }
+
+    return true;
+  }
+
+  std::uint64_t LibraryImage::getFingerprint() const
+  {
+    return header(m_data).m_fingerprint;
+  }
+
+  std::uint64_t LibraryImage::getDeclarationsHash() const
+  {
+    //everything after the header is built from the declarations alone
+    return hashContent(m_data + sizeof(ImageHeader), m_size - sizeof(ImageHeader));
+  }
+
+  int LibraryImage::findEntry(const std::string& name) const
+  {
+    std::uint32_t hashTableSize = header(m_data).m_hashTableSize;
+    std::uint32_t slot = hashLibraryName(name.data(), name.size(), 0) & (hashTableSize - 1);
+    for (std::uint32_t probes = 0; probes < hashTableSize && hashTable(m_data)[slot] != 0; ++probes)
+    {
+      int index = hashTable(m_data)[slot] - 1;
+      if (name == string(m_data, entries(m_data)[index].m_nameOffset))
+        return index;
+      slot = (slot + 1) & (hashTableSize - 1);
+    }
+
+    return -1;
+  }
+
+  bool LibraryImage::checkClassDefined(const std::string& className) const
+  {
+    int index = findEntry(className);
+    return index != -1 && (Symbol::SymbolKind)entries(m_data)[index].m_kind == Symbol::SymbolKind::CLASS;
+  }
+
+  bool LibraryImage::checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const
+  {
+    //libraries only declare subroutines, so variables of any kind can never match
+    if (symbolKind == Symbol::SymbolKind::ARGUMENT || symbolKind == Symbol::SymbolKind::VAR || symbolKind == Symbol::SymbolKind::FIELD || symbolKind == Symbol::SymbolKind::STATIC)
+      return false;
+
+    int index = findEntry(name);
+    return index != -1 && isSubroutineKind((Symbol::SymbolKind)entries(m_data)[index].m_kind);
+  }
+
+  std::pair<bool, std::string> LibraryImage::getSymbolType(const std::string& name) const
+  {
+    int index = findEntry(name);
+    if (index == -1 || !isSubroutineKind((Symbol::SymbolKind)entries(m_data)[index].m_kind))
+      return std::pair<bool, std::string>{false, "NO SUCH SYMBOL"};
+
+    return std::pair<bool, std::string>{true, string(m_data, entries(m_data)[index].m_typeOffset)};
+  }
+
+  const std::vector<std::string>* LibraryImage::getParameterList(const std::string& subroutineSymbolName) const
+  {
+    int index = findEntry(subroutineSymbolName);
+    if (index == -1 || !isSubroutineKind((Symbol::SymbolKind)entries(m_data)[index].m_kind))
+      return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_parameterListsMutex);
+    auto parameterList = m_parameterLists.find(index);
+    if (parameterList != m_parameterLists.end())
+      return &parameterList->second;
+
+    const ImageEntry& entry = entries(m_data)[index];
+    std::vector<std::string>& newParameterList = m_parameterLists[index];
+    for (std::uint32_t i = 0; i < entry.m_numParameters; ++i)
+      newParameterList.push_back(string(m_data, parameters(m_data)[entry.m_firstParameter + i]));
+
+    return &newParameterList;
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Library.h"
+#include "ClassInterface.h"
+
+namespace JackCompiler
+{
+  /**
+  * A library loaded from a compact binary signature file. The file is mapped into memory and queried in place through the hash
+  * table stored inside it, so even a large runtime library is loaded without building any symbol tables
+  */
+  class LibraryImage : public LibraryInterface
+  {
+  public:
+    /**
+    * Load the library found at path, which is either a binary signature file or a directory of .jack declaration stubs. A directory
+    * is only scanned when its stubs have changed - the resulting image is cached inside the directory and mapped on later runs
+    */
+    static std::shared_ptr<LibraryImage> load(const std::string& path);
+    /**
+    * Serialise the class interfaces into the binary signature file format
+    */
+    static std::vector<char> buildImage(const std::vector<ClassInterface>& classInterfaces, std::uint64_t fingerprint);
+    ~LibraryImage();
+
+    bool checkClassDefined(const std::string& className) const override;
+    bool checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const override;
+    std::pair<bool, std::string> getSymbolType(const std::string& name) const override;
+    const std::vector<std::string>* getParameterList(const std::string& subroutineSymbolName) const override;
+    /**
+    * Return a hash of the declarations in the library, which only changes when the declarations themselves change
+    */
+    std::uint64_t getDeclarationsHash() const;
+
+    //Name of the image cached inside a directory of declaration stubs
+    static const std::string m_cacheFileName;
+
+  private:
+    LibraryImage(const std::string& path, std::vector<char>&& data);
+    LibraryImage(const std::string& path, void* mapping, std::size_t size);
+    /**
+    * Map the file at path into memory, returning nullptr if it cannot be opened
+    */
+    static std::shared_ptr<LibraryImage> mapFile(const std::string& path);
+    /**
+    * Returns a boolean indicating whether the header and all of the offsets in the image describe a well formed signature file
+    */
+    bool isValid() const;
+    std::uint64_t getFingerprint() const;
+    /**
+    * Return the index of the entry with the given name, or -1 if the library does not declare it
+    */
+    int findEntry(const std::string& name) const;
+
+    std::string m_path;
+    std::vector<char> m_ownedData;
+    void* m_mapping;
+    const char* m_data;
+    std::size_t m_size;
+    //parameter lists are materialised as vectors the first time they are asked for
+    mutable std::mutex m_parameterListsMutex;
+    mutable std::unordered_map<int, std::vector<std::string>> m_parameterLists;
+  };
+}
@@ -1,20 +1,102 @@
 #include "Parser.h"
+#include "ClassInterface.h"
+#include "PassTimer.h"
 #include <algorithm>
+#include <sstream>
 
 namespace JackCompiler
 {
   void Parser::parse()
   {
+    ScopedPassTimer passTimer(Pass::PARSING);
+    DiagnosticsLocationScope diagnosticsLocationScope(m_filePath, [this](const std::string& lexeme) { return m_lexer.findTokenColumn(lexeme); });
+    //Streaming the code needs the number of class variables before the first constructor is generated, and pooling strings needs the
+    //number of static variables before the first string literal, so they are counted first
+    if (m_codeSink || m_poolStrings)
+      countClassVariables();
     jackProgram();
+    //the code passed on to the sink has been counted already
+    countPassEvents(PassCounter::INSTRUCTIONS, m_outputCode.size());
   }
 
-  void Parser::resolveSymbol(const std::string& name, const Symbol::SymbolKind& symbolKind, const std::vector<std::string>* parameterList)
+  void Parser::countClassVariables()
   {
+    //A file that cannot be scanned will not parse either, so the error is left for the parser to report
+    std::ostringstream scanDiagnostics;
+    DiagnosticsStreamScope diagnosticsStreamScope(scanDiagnostics);
+    try
+    {
+      std::vector<VariableDeclaration> variables = InterfaceScanner(m_filePath).scan().m_variables;
+      m_numClassVariables = variables.size();
+      m_numStaticVariables = std::count_if(variables.begin(), variables.end(), [](const VariableDeclaration& variable) { return variable.m_kind == Symbol::SymbolKind::STATIC; });
+    }
+    catch (const CompilationError&)
+    {
+    }
+  }
+
+  void Parser::pushPooledString(const std::string& str)
+  {
+    auto pooledStringIndex = m_pooledStringIndices.find(str);
+    if (pooledStringIndex == m_pooledStringIndices.end())
+    {
+      pooledStringIndex = m_pooledStringIndices.emplace(str, m_pooledStrings.size()).first;
+      m_pooledStrings.push_back(str);
+    }
+
+    //The pool is built all at once, so a string that is still null means none of them have been built. A built string is never null as
+    //it is allocated on the heap
+    std::string labelCount = std::to_string(getLabelCount());
+    std::size_t start = m_outputCode.size();
+    m_outputCode.addPush(VmSegment::STATIC, m_numStaticVariables + pooledStringIndex->second);
+    m_outputCode.addBranch(VmOpcode::IF_GOTO, "POOLED" + labelCount);
+    m_outputCode.addCall(m_className + ".$strings", 0);
+    m_outputCode.addPop(VmSegment::TEMP, 0);
+    m_outputCode.addBranch(VmOpcode::LABEL, "POOLED" + labelCount);
+    m_outputCode.addPush(VmSegment::STATIC, m_numStaticVariables + pooledStringIndex->second);
+
+    //without pooling the string is built with a call to String.new and one to String.appendChar for each character
+    ++m_stringPoolStatistics.m_stringLiterals;
+    m_stringPoolStatistics.m_stringInstructionsBefore += 2 + str.length() * 2;
+    m_stringPoolStatistics.m_stringInstructionsAfter += m_outputCode.size() - start;
+    m_stringPoolStatistics.m_stringCallsBefore += 1 + str.length();
+    ++m_stringPoolStatistics.m_stringCallsAfter;
+  }
+
+  void Parser::stringPoolInitialiser()
+  {
+    std::size_t start = m_outputCode.size();
+    m_outputCode.addFunction(m_className + ".$strings", 0);
+    for (std::size_t i = 0; i < m_pooledStrings.size(); ++i)
+    {
+      const std::string& str = m_pooledStrings[i];
+      m_outputCode.addPush(VmSegment::CONSTANT, str.length());
+      m_outputCode.addCall("String.new", 1);
+      for (char c : str)
+      {
+        m_outputCode.addPush(VmSegment::CONSTANT, (unsigned char)c);
+        m_outputCode.addCall("String.appendChar", 2);
+      }
+      m_outputCode.addPop(VmSegment::STATIC, m_numStaticVariables + i);
+      m_stringPoolStatistics.m_stringCallsAfter += 1 + str.length();
+    }
+    m_outputCode.addPush(VmSegment::CONSTANT, 0);
+    m_outputCode.addCommand(VmOpcode::RETURN);
+
+    m_stringPoolStatistics.m_pooledStrings += m_pooledStrings.size();
+    m_stringPoolStatistics.m_stringInstructionsAfter += m_outputCode.size() - start;
+    m_pooledStrings.clear();
+    m_pooledStringIndices.clear();
+  }
+
+  void Parser::resolveSymbol(std::list<SymbolToBeResolved>& symbolsToBeResolved, const std::string& name, const Symbol::SymbolKind& symbolKind, const std::vector<std::string>* parameterList)
+  {
+    ScopedPassTimer passTimer(Pass::RESOLUTION);
     std::vector<Symbol::SymbolKind> functionKinds {Symbol::SymbolKind::CONSTRUCTOR, Symbol::SymbolKind::FUNCTION, Symbol::SymbolKind::METHOD};
 
     //use the erase-remove idiom to go through the list of unresolved symbols and delete any symbols matching the arguments passed in
-    m_symbolsToBeResolved.erase(std::remove_if(m_symbolsToBeResolved.begin(),
-                                              m_symbolsToBeResolved.end(),
+    symbolsToBeResolved.erase(std::remove_if(symbolsToBeResolved.begin(),
+                                              symbolsToBeResolved.end(),
                                               [=](const SymbolToBeResolved& symbolToBeResolved)
                                               {
                                                 if (symbolToBeResolved.m_name == name && (symbolToBeResolved.m_kind == symbolKind || std::find(functionKinds.begin(), functionKinds.end(), symbolKind) != functionKinds.end()))
@@ -22,6 +104,8 @@ namespace JackCompiler
                                                   //check parameter list matches
                                                   if (parameterList)
                                                   {
+                                                    //the call being checked is in another file
+                                                    DiagnosticsLocationScope diagnosticsLocationScope(symbolToBeResolved.m_fileName);
                                                     if (symbolToBeResolved.m_parameterList.first)
                                                     {
                                                       if (parameterList->size() != symbolToBeResolved.m_parameterList.second.size())
@@ -41,7 +125,7 @@ namespace JackCompiler
                                                 }
                                                 return false;
                                               }),
-                                m_symbolsToBeResolved.end()
+                                symbolsToBeResolved.end()
     );
   }
 
@@ -62,20 +146,30 @@ namespace JackCompiler
   void Parser::resolveSymbols()
   {
     //get list of symbols that have been defined in the current class to resolve
-    std::list<std::shared_ptr<Symbol>> symbolsToResolve = m_symbolTables.getSymbolsFromCurrentSymbolTable();
-    for (auto symbol : symbolsToResolve)
+    resolveClassSymbols(m_symbolTables.getSymbolsFromCurrentSymbolTable(), m_className, m_symbolsToBeResolved);
+  }
+
+  void Parser::resolveClassSymbols(const std::list<std::shared_ptr<Symbol>>& classSymbols, const std::string& className, std::list<SymbolToBeResolved>& symbolsToBeResolved)
+  {
+    ScopedPassTimer passTimer(Pass::RESOLUTION);
+    for (auto symbol : classSymbols)
     {
-      resolveSymbol(symbol->m_name, symbol->m_kind, symbol->getParameterList());
+      resolveSymbol(symbolsToBeResolved, symbol->m_name, symbol->m_kind, symbol->getParameterList());
     }
 
     //resolve any class references
-    resolveSymbol(m_className, Symbol::SymbolKind::CLASS, nullptr);
+    resolveSymbol(symbolsToBeResolved, className, Symbol::SymbolKind::CLASS, nullptr);
   }
 
   bool Parser::determineIfNeedsToBeResolved(const std::string& symbolName, const Symbol::SymbolKind& symbolKind, std::pair<bool, std::vector<std::string>> parameterList)
   {
     if (isClassType(symbolName))
     {
+      //record the class so that the classes depending on each other can be worked out for separate compilation
+      std::string referencedClass = symbolName.substr(0, symbolName.find('.'));
+      if (referencedClass != m_className)
+        m_referencedClasses.insert(referencedClass);
+
       //attempt to find this class in a previous symbol table, otherwise add it to the list to be resolved later
       if (symbolName.find('.') == std::string::npos)
       {
@@ -157,9 +251,18 @@ namespace JackCompiler
           }
           if ((token = m_lexer.getNextToken()).m_lexeme == "}")
           {
-            //Set the number of words to allocate for the class if a constructor encountered
-            if (m_indexOfNumOfFieldsCode != -1)
-              m_outputCode.at(m_indexOfNumOfFieldsCode).append(std::to_string(m_numFieldVariables));
+            //Set the number of words to allocate for the class in any constructors still waiting for it, then pass on the remaining code
+            for (int indexOfNumOfFieldsCode : m_indicesOfNumOfFieldsCode)
+              m_outputCode.getInstructions().at(indexOfNumOfFieldsCode).m_operand = m_numFieldVariables;
+            m_indicesOfNumOfFieldsCode.clear();
+            if (!m_pooledStrings.empty())
+              stringPoolInitialiser();
+            if (m_codeSink)
+            {
+              countPassEvents(PassCounter::INSTRUCTIONS, m_outputCode.size());
+              m_codeSink->writeCode(m_outputCode);
+              m_outputCode.clearInstructions();
+            }
 
             //Resolve all the symbols that were defined in this class
             resolveSymbols();
@@ -292,23 +395,28 @@ namespace JackCompiler
             }
 
             //Output the declaration of the function and record its position within the output array so that its number of local variables can be set after the body has been parsed
-            m_outputCode.push_back("function " + newSymbolName + " ");
+            m_outputCode.addFunction(newSymbolName, 0);
             int indexOfFunctionDeclarationCode = m_outputCode.size() - 1;
 
             //If the subroutine is a constructor then add the necessary call to the library function to allocate space for the object
             if (newSymbolKind == Symbol::SymbolKind::CONSTRUCTOR)
             {
-              m_outputCode.push_back("push constant ");
-              m_indexOfNumOfFieldsCode = m_outputCode.size() - 1;
-              m_outputCode.push_back("call Memory.alloc 1");
-              m_outputCode.push_back("pop pointer 0");
+              if (m_numClassVariables != -1)
+                m_outputCode.addPush(VmSegment::CONSTANT, m_numClassVariables);
+              else
+              {
+                m_outputCode.addPush(VmSegment::CONSTANT, 0);
+                m_indicesOfNumOfFieldsCode.push_back(m_outputCode.size() - 1);
+              }
+              m_outputCode.addCall("Memory.alloc", 1);
+              m_outputCode.addPop(VmSegment::POINTER, 0);
             }
 
             //If the subroutine is a method then set the this segment to point at the correct object, passed in as an implicit first argument to the method
             if (newSymbolKind == Symbol::SymbolKind::METHOD)
             {
-              m_outputCode.push_back("push argument 0");
-              m_outputCode.push_back("pop pointer 0");
+              m_outputCode.addPush(VmSegment::ARGUMENT, 0);
+              m_outputCode.addPop(VmSegment::POINTER, 0);
             }
 
             //If the body of the function does not return a value down all its code paths then raise an error
@@ -316,7 +424,17 @@ namespace JackCompiler
               compilerError("Not all code paths in the subroutine contain a return statement", m_lexer.getLineNum(), "}");
 
             //Set the number of local variables in the function definition
-            m_outputCode.at(indexOfFunctionDeclarationCode).append(std::to_string(m_numLocalVariables));
+            m_outputCode.getInstructions().at(indexOfFunctionDeclarationCode).m_operand = m_numLocalVariables;
+            if (m_optimiser)
+              m_optimiser->optimiseSubroutine(m_outputCode, indexOfFunctionDeclarationCode);
+
+            //The finished subroutine can be passed on, unless a constructor is still waiting for the number of fields
+            if (m_codeSink && m_indicesOfNumOfFieldsCode.empty())
+            {
+              countPassEvents(PassCounter::INSTRUCTIONS, m_outputCode.size());
+              m_codeSink->writeCode(m_outputCode);
+              m_outputCode.clearInstructions();
+            }
 
             //remove symbol table for this subroutine scope
             m_symbolTables.removeCurrentSymbolTable();
@@ -505,14 +623,14 @@ namespace JackCompiler
           if (offsetAndKind.second == Symbol::SymbolKind::FIELD)
           {
             //set this pointer to point at the this object
-            m_outputCode.push_back("push this " + std::to_string(offsetAndKind.first));
+            m_outputCode.addPush(VmSegment::THIS, offsetAndKind.first);
           }
           else if (offsetAndKind.second == Symbol::SymbolKind::STATIC)
-            m_outputCode.push_back("push static " + std::to_string(offsetAndKind.first));
+            m_outputCode.addPush(VmSegment::STATIC, offsetAndKind.first);
           else if (offsetAndKind.second == Symbol::SymbolKind::ARGUMENT)
-            m_outputCode.push_back("push argument " + std::to_string(offsetAndKind.first));
+            m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
           else
-            m_outputCode.push_back("push local " + std::to_string(offsetAndKind.first));      
+            m_outputCode.addPush(VmSegment::LOCAL, offsetAndKind.first);      
 
           m_lexer.getNextToken();
           std::string expressionType = expression();
@@ -523,8 +641,8 @@ namespace JackCompiler
           {
             leftHandSideType = "any";
             //Generate VM code to index the array
-            m_outputCode.push_back("add");
-            m_outputCode.push_back("pop pointer 1");
+            m_outputCode.addCommand(VmOpcode::ADD);
+            m_outputCode.addPop(VmSegment::POINTER, 1);
             arrayElement = true;
           }
           else
@@ -551,20 +669,20 @@ namespace JackCompiler
 
             //If the assigned variable was an element of an array then that location will be pointed at by the 'that' pointer so pop the value into that location
             if (arrayElement)
-              m_outputCode.push_back("pop that 0");
+              m_outputCode.addPop(VmSegment::THAT, 0);
             else
             {
               //Get the offset and kind of symbol in order to generate the correct vm code
               auto offsetAndKind = m_symbolTables.getOffsetAndKind(symbolName, m_className);
 
               if (offsetAndKind.second == Symbol::SymbolKind::FIELD)
-                m_outputCode.push_back("pop this " + std::to_string(offsetAndKind.first));
+                m_outputCode.addPop(VmSegment::THIS, offsetAndKind.first);
               else if (offsetAndKind.second == Symbol::SymbolKind::STATIC)
-                m_outputCode.push_back("pop static " + std::to_string(offsetAndKind.first));
+                m_outputCode.addPop(VmSegment::STATIC, offsetAndKind.first);
               else if (offsetAndKind.second == Symbol::SymbolKind::ARGUMENT)
-                m_outputCode.push_back("pop argument " + std::to_string(offsetAndKind.first));
+                m_outputCode.addPop(VmSegment::ARGUMENT, offsetAndKind.first);
               else
-                m_outputCode.push_back("pop local " + std::to_string(offsetAndKind.first));      
+                m_outputCode.addPop(VmSegment::LOCAL, offsetAndKind.first);      
             }
           }
           else
@@ -588,25 +706,25 @@ namespace JackCompiler
     if (token.m_lexeme == "if")
     {
       std::string labelCount = std::to_string(getLabelCount());
-      m_outputCode.push_back("label IF" + labelCount);
+      m_outputCode.addBranch(VmOpcode::LABEL, "IF" + labelCount);
       if ((token = m_lexer.getNextToken()).m_lexeme == "(")
       {
         expression();
-        m_outputCode.push_back("not");
-        m_outputCode.push_back("if-goto ELSE" + labelCount);
+        m_outputCode.addCommand(VmOpcode::NOT);
+        m_outputCode.addBranch(VmOpcode::IF_GOTO, "ELSE" + labelCount);
         if ((token = m_lexer.getNextToken()).m_lexeme == ")")
         {
           ifPortionReturned = body();
-          m_outputCode.push_back("goto END" + labelCount);
-          m_outputCode.push_back("label ELSE" + labelCount);
+          m_outputCode.addBranch(VmOpcode::GOTO, "END" + labelCount);
+          m_outputCode.addBranch(VmOpcode::LABEL, "ELSE" + labelCount);
           Token nextToken = m_lexer.peekNextToken();
           if (nextToken.m_lexeme == "else")
           {
             m_lexer.getNextToken();
             elsePortionReturned = body();
           }
-          m_outputCode.push_back("goto END" + labelCount);
-          m_outputCode.push_back("label END" + labelCount);
+          m_outputCode.addBranch(VmOpcode::GOTO, "END" + labelCount);
+          m_outputCode.addBranch(VmOpcode::LABEL, "END" + labelCount);
           //Both the if and else portion of the statement must contain return statements for the whole portion of the code to definitely return a value
           if (ifPortionReturned && elsePortionReturned)
             m_returnsValue = true;
@@ -627,17 +745,17 @@ namespace JackCompiler
     if (token.m_lexeme == "while")
     {
       std::string labelCount = std::to_string(getLabelCount());
-      m_outputCode.push_back("label LOOP" + labelCount);
+      m_outputCode.addBranch(VmOpcode::LABEL, "LOOP" + labelCount);
       if ((token = m_lexer.getNextToken()).m_lexeme == "(")
       {
         expression();
-        m_outputCode.push_back("not");
-        m_outputCode.push_back("if-goto END" + labelCount);
+        m_outputCode.addCommand(VmOpcode::NOT);
+        m_outputCode.addBranch(VmOpcode::IF_GOTO, "END" + labelCount);
         if ((token = m_lexer.getNextToken()).m_lexeme == ")")
         {
           body();
-          m_outputCode.push_back("goto LOOP" + labelCount);
-          m_outputCode.push_back("label END" + labelCount);
+          m_outputCode.addBranch(VmOpcode::GOTO, "LOOP" + labelCount);
+          m_outputCode.addBranch(VmOpcode::LABEL, "END" + labelCount);
         }
         else
           compilerError("Expected the SYMBOL ')' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -657,7 +775,7 @@ namespace JackCompiler
       subroutineCall();
       if ((token = m_lexer.getNextToken()).m_lexeme == ";")
       {
-        m_outputCode.push_back("pop temp 0");
+        m_outputCode.addPop(VmSegment::TEMP, 0);
       }
       else
         compilerError("Expected the SYMBOL ';' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -686,13 +804,13 @@ namespace JackCompiler
         if (m_scopeReturnType != "void")
           compilerError("Expected subroutine to return a value of type " + m_scopeReturnType, m_lexer.getLineNum(), nextToken.m_lexeme);
         
-        m_outputCode.push_back("push constant 0");
+        m_outputCode.addPush(VmSegment::CONSTANT, 0);
       }
       
       if ((token = m_lexer.getNextToken()).m_lexeme == ";")
       {
         m_returnsValue = true;
-        m_outputCode.push_back("return");
+        m_outputCode.addCommand(VmOpcode::RETURN);
       }
       else
         compilerError("Expected the SYMBOL ';' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -771,21 +889,21 @@ namespace JackCompiler
           auto offsetAndKind = m_symbolTables.getOffsetAndKind(prefixFunctionName, m_className);
 
           if (offsetAndKind.first == -1)
-            m_outputCode.push_back("push pointer 0");
+            m_outputCode.addPush(VmSegment::POINTER, 0);
           else
           {
             if (offsetAndKind.second == Symbol::SymbolKind::FIELD)
             {
-              m_outputCode.push_back("push this " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::THIS, offsetAndKind.first);
             }
             else if (offsetAndKind.second == Symbol::SymbolKind::STATIC)
-              m_outputCode.push_back("push static " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::STATIC, offsetAndKind.first);
             else if (offsetAndKind.second == Symbol::SymbolKind::ARGUMENT)
-              m_outputCode.push_back("push argument " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
             else if (offsetAndKind.second == Symbol::SymbolKind::VAR)
-              m_outputCode.push_back("push local " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::LOCAL, offsetAndKind.first);
             else
-              m_outputCode.push_back("push argument 0" + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
           }
         }
         
@@ -804,7 +922,7 @@ namespace JackCompiler
 
         if ((token = m_lexer.getNextToken()).m_lexeme == ")")
         {
-          m_outputCode.push_back("call " + functionName + " " + std::to_string(argumentCount));
+          m_outputCode.addCall(functionName, argumentCount);
         }
         else
           compilerError("Expected the SYMBOL ')' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -847,11 +965,11 @@ namespace JackCompiler
 
       //Output the correct boolean instruction that corresponds to the token operator
       if (nextToken.m_lexeme == "=")
-        m_outputCode.push_back("eq");
+        m_outputCode.addCommand(VmOpcode::EQ);
       else if (nextToken.m_lexeme == ">")
-        m_outputCode.push_back("gt");
+        m_outputCode.addCommand(VmOpcode::GT);
       else
-        m_outputCode.push_back("lt");
+        m_outputCode.addCommand(VmOpcode::LT);
 
       nextToken = m_lexer.peekNextToken();
     }
@@ -872,9 +990,9 @@ namespace JackCompiler
 
       //Output the correct instruction for the corresponding operator
       if (nextToken.m_lexeme == "+")
-        m_outputCode.push_back("add");
+        m_outputCode.addCommand(VmOpcode::ADD);
       else
-        m_outputCode.push_back("sub");
+        m_outputCode.addCommand(VmOpcode::SUB);
 
       nextToken = m_lexer.peekNextToken();
     }
@@ -895,9 +1013,9 @@ namespace JackCompiler
       
       //Output the correct call to the math library (no inbuilt multiply and divide instructions in the HACK architecture so need to call a library function)
       if (nextToken.m_lexeme == "*")
-        m_outputCode.push_back("call Math.multiply 2");
+        m_outputCode.addCall("Math.multiply", 2);
       else
-        m_outputCode.push_back("call Math.divide 2");
+        m_outputCode.addCall("Math.divide", 2);
 
       nextToken = m_lexer.peekNextToken();
     }
@@ -917,9 +1035,9 @@ namespace JackCompiler
 
     //Output the correct unary operator if the preceding token to the operand was indeed an operator
     if (nextToken.m_lexeme == "-")
-      m_outputCode.push_back("neg");
+      m_outputCode.addCommand(VmOpcode::NEG);
     else if (nextToken.m_lexeme == "~")
-      m_outputCode.push_back("not");
+      m_outputCode.addCommand(VmOpcode::NOT);
 
     return factorType;
   }
@@ -932,7 +1050,10 @@ namespace JackCompiler
     {
       operandType = "int";
       std::string intToPush = m_lexer.getNextToken().m_lexeme;
-      m_outputCode.push_back("push constant " + intToPush);
+      //the largest integer a constant can hold is 32767, so longer numbers are rejected before they are converted
+      if (intToPush.size() - std::min(intToPush.find_first_not_of('0'), intToPush.size()) > 5 || std::stoi(intToPush) > 32767)
+        compilerError("Integer constant is out of range, the largest allowed is 32767", m_lexer.getLineNum(), intToPush);
+      m_outputCode.addPush(VmSegment::CONSTANT, std::stoi(intToPush));
     }
     else if (nextToken.m_tokenType == Token::TokenType::IDENTIFIER)
     {
@@ -994,13 +1115,13 @@ namespace JackCompiler
         auto offsetAndKind = m_symbolTables.getOffsetAndKind(symbolName, m_className);
         
         if (offsetAndKind.second == Symbol::SymbolKind::FIELD)
-          m_outputCode.push_back("push this " + std::to_string(offsetAndKind.first));
+          m_outputCode.addPush(VmSegment::THIS, offsetAndKind.first);
         else if (offsetAndKind.second == Symbol::SymbolKind::STATIC)
-          m_outputCode.push_back("push static " + std::to_string(offsetAndKind.first));
+          m_outputCode.addPush(VmSegment::STATIC, offsetAndKind.first);
         else if (offsetAndKind.second == Symbol::SymbolKind::ARGUMENT)
-          m_outputCode.push_back("push argument " + std::to_string(offsetAndKind.first));
+          m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
         else
-          m_outputCode.push_back("push local " + std::to_string(offsetAndKind.first));
+          m_outputCode.addPush(VmSegment::LOCAL, offsetAndKind.first);
       }
       else
       {
@@ -1010,21 +1131,21 @@ namespace JackCompiler
           auto offsetAndKind = m_symbolTables.getOffsetAndKind(prefixSymbolName, m_className);
 
           if (offsetAndKind.first == -1)
-            m_outputCode.push_back("push pointer 0");
+            m_outputCode.addPush(VmSegment::POINTER, 0);
           else
           {
             if (offsetAndKind.second == Symbol::SymbolKind::FIELD)
             {
-              m_outputCode.push_back("push this " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::THIS, offsetAndKind.first);
             }
             else if (offsetAndKind.second == Symbol::SymbolKind::STATIC)
-              m_outputCode.push_back("push static " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::STATIC, offsetAndKind.first);
             else if (offsetAndKind.second == Symbol::SymbolKind::ARGUMENT)
-              m_outputCode.push_back("push argument " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
             else if (offsetAndKind.second == Symbol::SymbolKind::VAR)
-              m_outputCode.push_back("push local " + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::LOCAL, offsetAndKind.first);
             else
-              m_outputCode.push_back("push argument 0" + std::to_string(offsetAndKind.first));
+              m_outputCode.addPush(VmSegment::ARGUMENT, offsetAndKind.first);
           }
         }
       }
@@ -1044,9 +1165,9 @@ namespace JackCompiler
         if (token.m_lexeme == "]")
         {
           //Generate code needed to index the array
-          m_outputCode.push_back("add");
-          m_outputCode.push_back("pop pointer 1");
-          m_outputCode.push_back("push that 0");
+          m_outputCode.addCommand(VmOpcode::ADD);
+          m_outputCode.addPop(VmSegment::POINTER, 1);
+          m_outputCode.addPush(VmSegment::THAT, 0);
         }
         else
           compilerError("Expected the SYMBOL ']' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -1073,7 +1194,7 @@ namespace JackCompiler
         Token token = m_lexer.getNextToken();
         if (token.m_lexeme == ")")
         {
-          m_outputCode.push_back("call " + symbolName + " " + std::to_string(argumentCount));
+          m_outputCode.addCall(symbolName, argumentCount);
         }
         else
           compilerError("Expected the SYMBOL ')' at this position", m_lexer.getLineNum(), token.m_lexeme);
@@ -1098,37 +1219,42 @@ namespace JackCompiler
       std::string str = nextToken.m_lexeme.substr(1, nextToken.m_lexeme.length() - 2);
 
       //Output VM code to create a new string and append the character codes of from the string literal
-      m_outputCode.push_back("push constant " + std::to_string(str.length()));
-      m_outputCode.push_back("call String.new 1");
-      for (char& c : str)
+      if (m_poolStrings && m_numStaticVariables != -1)
+        pushPooledString(str);
+      else
       {
-        m_outputCode.push_back("push constant " + std::to_string((int)c));
-        m_outputCode.push_back("call String.appendChar 2");
+        m_outputCode.addPush(VmSegment::CONSTANT, str.length());
+        m_outputCode.addCall("String.new", 1);
+        for (char& c : str)
+        {
+          m_outputCode.addPush(VmSegment::CONSTANT, (unsigned char)c);
+          m_outputCode.addCall("String.appendChar", 2);
+        }
       }
     }
     else if (nextToken.m_lexeme == "true")
     {
       m_lexer.getNextToken();
       operandType = "boolean";
-      m_outputCode.push_back("push constant 1");
+      m_outputCode.addPush(VmSegment::CONSTANT, 1);
     }
     else if (nextToken.m_lexeme == "false")
     {
       m_lexer.getNextToken();
       operandType = "boolean";
-      m_outputCode.push_back("push constant 0");
+      m_outputCode.addPush(VmSegment::CONSTANT, 0);
     }
     else if (nextToken.m_lexeme == "null")
     {
       m_lexer.getNextToken();
       operandType = "any";
-      m_outputCode.push_back("push constant 0");
+      m_outputCode.addPush(VmSegment::CONSTANT, 0);
     }
     else if (nextToken.m_lexeme == "this")
     {
       m_lexer.getNextToken();
       operandType = m_className;
-      m_outputCode.push_back("push pointer 0");
+      m_outputCode.addPush(VmSegment::POINTER, 0);
     }
     else
       compilerError("Expected an INTEGERCONSTANT, an IDENTIFIER, the SYMBOL '(', a STRINGCONSTANT, the KEYWORD 'true', the KEYWORD 'false', the KEYWORD 'null' or the KEYWORD 'this' at this position", m_lexer.getLineNum(), nextToken.m_lexeme);
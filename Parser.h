@@ -3,36 +3,83 @@
 #include "Core.h"
 #include "SymbolTable.h"
 #include "Lexer.h"
+#include "VmCode.h"
+#include "VmOptimiser.h"
 
 #include <list>
+#include <set>
+#include <unordered_map>
 
 namespace JackCompiler
 {
+  /**
+  * Receives the vm code of a class as it is generated, a finished subroutine at a time
+  */
+  class CodeSink
+  {
+  public:
+    virtual ~CodeSink() {}
+    virtual void writeCode(const VmCode& code) = 0;
+  };
+
   class Parser
   {
   public:
-    Parser(const std::string& filePath, SymbolTables& symbolTables, std::list<SymbolToBeResolved>& symbolsToBeResolved) : m_lexer(filePath), m_symbolTables(symbolTables), m_symbolsToBeResolved(symbolsToBeResolved), m_filePath(filePath), m_returnsValue(false), m_labelCount(0), m_numLocalVariables(0), m_numFieldVariables(0), m_indexOfNumOfFieldsCode(-1) {}
+    /**
+    * If a code sink is given, the code of each subroutine is passed to it as soon as the subroutine is finished, so that only one
+    * subroutine's code is held at a time. If an optimiser is given, the code of each subroutine is optimised as soon as it is finished.
+    * If strings are pooled, each distinct string literal of the class is built once and kept in a static variable
+    */
+    Parser(const std::string& filePath, SymbolTables& symbolTables, std::list<SymbolToBeResolved>& symbolsToBeResolved, CodeSink* codeSink = nullptr, VmOptimiser* optimiser = nullptr, bool poolStrings = false) : m_lexer(filePath), m_symbolTables(symbolTables), m_symbolsToBeResolved(symbolsToBeResolved), m_filePath(filePath), m_returnsValue(false), m_labelCount(0), m_numLocalVariables(0), m_numFieldVariables(0), m_numClassVariables(-1), m_numStaticVariables(-1), m_codeSink(codeSink), m_optimiser(optimiser), m_poolStrings(poolStrings) {}
     /**
     * compile the file by performing lexical analysis and syntactical analysis, whilst checking the semantics and generating the target vm code
     */
     void parse();
-    const std::vector<std::string>& getOutputCode() const { return m_outputCode; }
+    /**
+    * Returns the generated code that has not been passed to the code sink - all of it if there is no code sink
+    */
+    const VmCode& getOutputCode() const { return m_outputCode; }
+    const std::string& getClassName() const { return m_className; }
+    /**
+    * Returns the names of the other classes that the compiled class refers to
+    */
+    const std::set<std::string>& getReferencedClasses() const { return m_referencedClasses; }
+    /**
+    * Returns the counts of the string literals pooled - the other statistics are left at zero
+    */
+    const OptimisationStatistics& getStringPoolStatistics() const { return m_stringPoolStatistics; }
+    /**
+    * Resolve the symbols waiting for the given class symbols to be defined - used when a class is added to the symbol tables
+    * without being parsed
+    */
+    static void resolveClassSymbols(const std::list<std::shared_ptr<Symbol>>& classSymbols, const std::string& className, std::list<SymbolToBeResolved>& symbolsToBeResolved);
 
   private:
     //Lexer object to tokenise the input file
     Lexer m_lexer;
     //Symbol table object that are needed to store all symbol details for semantic analysis and code generation
     SymbolTables& m_symbolTables;
-    //List to store all the output vm instructions
-    std::vector<std::string> m_outputCode;
+    //The output vm instructions
+    VmCode m_outputCode;
     //Used to assign unique names to any labels
     int m_labelCount;
     //Used to record the number of local variables in a subroutine, needed when defining the subroutine in the vm code
     int m_numLocalVariables;
     //Used to record the number of fields in the class, needed when allocating space in the constructor
     int m_numFieldVariables;
-    //Records the index into the m_outputCode list where the amount of memory needed to be allocated is specified (in the constructor) to be adjusted later
-    int m_indexOfNumOfFieldsCode;
+    //Records the indices of the instructions in m_outputCode that push the amount of memory to be allocated (in the constructors) to be adjusted later
+    std::vector<int> m_indicesOfNumOfFieldsCode;
+    //Number of variables declared by the class, read before parsing when the code is streamed so constructors can be finished straight away, or -1 if unknown
+    int m_numClassVariables;
+    //Number of static variables declared by the class, read before parsing when strings are pooled so the pool can be put after them, or -1 if unknown
+    int m_numStaticVariables;
+    CodeSink* m_codeSink;
+    VmOptimiser* m_optimiser;
+    bool m_poolStrings;
+    //The distinct string literals of the class in the order they were first used, each kept in the static variable after the previous one
+    std::vector<std::string> m_pooledStrings;
+    std::unordered_map<std::string, int> m_pooledStringIndices;
+    OptimisationStatistics m_stringPoolStatistics;
     //List of symbols that are unresolved - should be empty by the end of compilation
     std::list<SymbolToBeResolved>& m_symbolsToBeResolved;
     //Name of the current class
@@ -43,10 +90,12 @@ namespace JackCompiler
     std::string m_scopeReturnType;
     //Records whether the current block of code returns a value on all code paths
     bool m_returnsValue;
+    //Names of the other classes used as data types or called into by the current class
+    std::set<std::string> m_referencedClasses;
     /**
     * Removes any occurrences of the symbol passed in from the unresolvedSymbols list
     */
-    void resolveSymbol(const std::string& name, const Symbol::SymbolKind& symbolKind, const std::vector<std::string>* parameterList);
+    static void resolveSymbol(std::list<SymbolToBeResolved>& symbolsToBeResolved, const std::string& name, const Symbol::SymbolKind& symbolKind, const std::vector<std::string>* parameterList);
     /**
     * Returns a boolean indicating whether the data type passed in is a class or not
     */
@@ -71,6 +120,18 @@ namespace JackCompiler
     void compareArgumentListToParameterList(const std::vector<std::string>* parameterList, const std::vector<std::string>& expressionListDataTypes) const;
 
     int getLabelCount() { return m_labelCount++; }
+    /**
+    * Count the static and field variables declared by the class without parsing it, leaving the counts at -1 if the file cannot be scanned
+    */
+    void countClassVariables();
+    /**
+    * Output the code pushing a string literal kept in the pool, building the strings of the class first if they have not been built
+    */
+    void pushPooledString(const std::string& str);
+    /**
+    * Output the function building every pooled string of the class, called the first time one of them is used
+    */
+    void stringPoolInitialiser();
 
     /*
       All the methods that form the recursive descent parser
@@ -0,0 +1,248 @@
+#include "PassTimer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char* const s_passNames[] =
+    {
+      "loading libraries",
+      "change detection",
+      "scanning declarations",
+      "ordering files",
+      "cache lookups",
+      "lexing",
+      "parsing and code generation",
+      "symbol tables",
+      "deferred resolution",
+      "optimisation",
+      "writing output"
+    };
+
+    const char* const s_counterNames[] = {"tokens", "symbols", "lookups", "instructions"};
+
+#ifndef JACK_NO_PASS_TIMING
+    //the timings being recorded on this thread, the innermost running timer and the file being compiled
+    thread_local PassTimings* t_passTimings = nullptr;
+    thread_local ScopedPassTimer* t_currentTimer = nullptr;
+    thread_local FileTimings* t_currentFile = nullptr;
+#endif
+
+    std::string toMilliseconds(std::uint64_t nanoseconds)
+    {
+      std::ostringstream milliseconds;
+      milliseconds << std::fixed << std::setprecision(2) << nanoseconds / 1000000.0;
+      return milliseconds.str();
+    }
+
+    std::string toJsonString(const std::string& value)
+    {
+      std::string json = "\"";
+      for (char character : value)
+      {
+        if (character == '"' || character == '\\')
+          json.push_back('\\');
+        json.push_back(character);
+      }
+      return json + "\"";
+    }
+
+    /**
+    * Return the time of the build not spent in any pass
+    */
+    PassTime getUnaccountedTime(const PassTimings& timings, const PassTime& buildTime)
+    {
+      PassTime accountedTime;
+      for (const PassTime& passTime : timings.m_passes)
+        accountedTime += passTime;
+
+      PassTime unaccountedTime;
+      unaccountedTime.m_wallNanoseconds = buildTime.m_wallNanoseconds > accountedTime.m_wallNanoseconds ? buildTime.m_wallNanoseconds - accountedTime.m_wallNanoseconds : 0;
+      unaccountedTime.m_cpuNanoseconds = buildTime.m_cpuNanoseconds > accountedTime.m_cpuNanoseconds ? buildTime.m_cpuNanoseconds - accountedTime.m_cpuNanoseconds : 0;
+      return unaccountedTime;
+    }
+  }
+
+  const char* getPassName(Pass pass)
+  {
+    return s_passNames[(int)pass];
+  }
+
+  const char* getPassCounterName(PassCounter counter)
+  {
+    return s_counterNames[(int)counter];
+  }
+
+  PassTime& PassTime::operator += (const PassTime& time)
+  {
+    m_wallNanoseconds += time.m_wallNanoseconds;
+    m_cpuNanoseconds += time.m_cpuNanoseconds;
+    return *this;
+  }
+
+  void PassTimings::merge(const PassTimings& timings)
+  {
+    for (int i = 0; i < (int)Pass::NUM_PASSES; ++i)
+      m_passes[i] += timings.m_passes[i];
+    for (int i = 0; i < (int)PassCounter::NUM_COUNTERS; ++i)
+      m_counts[i] += timings.m_counts[i];
+    m_files.insert(m_files.end(), timings.m_files.begin(), timings.m_files.end());
+  }
+
+  void PassStopwatch::start()
+  {
+    struct timespec cpuTime;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+    m_startTime.m_cpuNanoseconds = (std::uint64_t)cpuTime.tv_sec * 1000000000 + cpuTime.tv_nsec;
+    m_startTime.m_wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  PassTime PassStopwatch::getElapsedTime() const
+  {
+    PassStopwatch now;
+    now.start();
+    PassTime elapsedTime;
+    elapsedTime.m_wallNanoseconds = now.m_startTime.m_wallNanoseconds - m_startTime.m_wallNanoseconds;
+    elapsedTime.m_cpuNanoseconds = now.m_startTime.m_cpuNanoseconds - m_startTime.m_cpuNanoseconds;
+    return elapsedTime;
+  }
+
+#ifndef JACK_NO_PASS_TIMING
+  PassTimingsScope::PassTimingsScope(PassTimings* timings) : m_previousTimings(t_passTimings)
+  {
+    //A timer running outside the scope still leaves out the time of the timers inside it, even though they record elsewhere
+    t_passTimings = timings;
+  }
+
+  PassTimingsScope::~PassTimingsScope()
+  {
+    t_passTimings = m_previousTimings;
+  }
+
+  ScopedPassTimer::ScopedPassTimer(Pass pass) : m_pass(pass), m_timings(t_passTimings), m_parent(nullptr)
+  {
+    if (!m_timings)
+      return;
+    m_parent = t_currentTimer;
+    t_currentTimer = this;
+    m_stopwatch.start();
+  }
+
+  ScopedPassTimer::ScopedPassTimer(Pass pass, PassCounter counter) : ScopedPassTimer(pass)
+  {
+    countPassEvents(counter, 1);
+  }
+
+  ScopedPassTimer::~ScopedPassTimer()
+  {
+    if (!m_timings)
+      return;
+
+    PassTime elapsedTime = m_stopwatch.getElapsedTime();
+    PassTime& passTime = m_timings->m_passes[(int)m_pass];
+    passTime.m_wallNanoseconds += elapsedTime.m_wallNanoseconds - std::min(m_childTime.m_wallNanoseconds, elapsedTime.m_wallNanoseconds);
+    passTime.m_cpuNanoseconds += elapsedTime.m_cpuNanoseconds - std::min(m_childTime.m_cpuNanoseconds, elapsedTime.m_cpuNanoseconds);
+    if (m_parent)
+      m_parent->m_childTime += elapsedTime;
+    t_currentTimer = m_parent;
+  }
+
+  FileTimingScope::FileTimingScope(const std::string& filePath) : m_timings(t_passTimings), m_previousFile(t_currentFile)
+  {
+    if (!m_timings)
+      return;
+    m_file.m_filePath = filePath;
+    t_currentFile = &m_file;
+    m_stopwatch.start();
+  }
+
+  FileTimingScope::~FileTimingScope()
+  {
+    if (!m_timings)
+      return;
+    m_file.m_time = m_stopwatch.getElapsedTime();
+    m_timings->m_files.push_back(m_file);
+    t_currentFile = m_previousFile;
+  }
+
+  void countPassEvents(PassCounter counter, std::uint64_t numEvents)
+  {
+    if (!t_passTimings)
+      return;
+    t_passTimings->m_counts[(int)counter] += numEvents;
+    if (t_currentFile)
+      t_currentFile->m_counts[(int)counter] += numEvents;
+  }
+#endif
+
+  std::string formatPassTimings(const PassTimings& timings, const PassTime& buildTime)
+  {
+    std::ostringstream text;
+    text << "Time per pass:" << '\n';
+    text << "  " << std::left << std::setw(30) << "pass" << std::right << std::setw(12) << "wall ms" << std::setw(12) << "CPU ms" << '\n';
+    auto printLine = [&text](const std::string& name, const PassTime& time)
+    {
+      text << "  " << std::left << std::setw(30) << name << std::right << std::setw(12) << toMilliseconds(time.m_wallNanoseconds) << std::setw(12) <<
+              toMilliseconds(time.m_cpuNanoseconds) << '\n';
+    };
+
+    for (int i = 0; i < (int)Pass::NUM_PASSES; ++i)
+      printLine(s_passNames[i], timings.m_passes[i]);
+    printLine("other", getUnaccountedTime(timings, buildTime));
+    printLine("total", buildTime);
+
+    text << "Counts:";
+    for (int i = 0; i < (int)PassCounter::NUM_COUNTERS; ++i)
+      text << (i == 0 ? " " : ", ") << timings.m_counts[i] << " " << s_counterNames[i];
+    text << '\n';
+
+    if (timings.m_files.empty())
+      return text.str();
+
+    text << "Time per file:" << '\n';
+    text << "  " << std::right << std::setw(12) << "wall ms" << std::setw(12) << "CPU ms";
+    for (const char* counterName : s_counterNames)
+      text << std::setw(14) << counterName;
+    text << "  file" << '\n';
+    for (const FileTimings& file : timings.m_files)
+    {
+      text << "  " << std::setw(12) << toMilliseconds(file.m_time.m_wallNanoseconds) << std::setw(12) << toMilliseconds(file.m_time.m_cpuNanoseconds);
+      for (std::uint64_t count : file.m_counts)
+        text << std::setw(14) << count;
+      text << "  " << file.m_filePath << '\n';
+    }
+    return text.str();
+  }
+
+  std::string formatPassTimingsAsJson(const PassTimings& timings, const PassTime& buildTime)
+  {
+    auto formatTime = [](const PassTime& time)
+    {
+      return "\"wallMs\":" + toMilliseconds(time.m_wallNanoseconds) + ",\"cpuMs\":" + toMilliseconds(time.m_cpuNanoseconds);
+    };
+    auto formatCounts = [](const std::uint64_t* counts)
+    {
+      std::string json;
+      for (int i = 0; i < (int)PassCounter::NUM_COUNTERS; ++i)
+        json += ",\"" + std::string(s_counterNames[i]) + "\":" + std::to_string(counts[i]);
+      return json;
+    };
+
+    std::string json = "{" + formatTime(buildTime) + formatCounts(timings.m_counts) + ",\"passes\":[";
+    for (int i = 0; i < (int)Pass::NUM_PASSES; ++i)
+      json += std::string(i == 0 ? "" : ",") + "{\"name\":" + toJsonString(s_passNames[i]) + "," + formatTime(timings.m_passes[i]) + "}";
+    json += ",{\"name\":\"other\"," + formatTime(getUnaccountedTime(timings, buildTime)) + "}],\"files\":[";
+    for (std::size_t i = 0; i < timings.m_files.size(); ++i)
+    {
+      const FileTimings& file = timings.m_files[i];
+      json += std::string(i == 0 ? "" : ",") + "{\"file\":" + toJsonString(file.m_filePath) + "," + formatTime(file.m_time) + formatCounts(file.m_counts) + "}";
+    }
+    return json + "]}";
+  }
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace JackCompiler
+{
+  /**
+  * The phases of a build that --time-passes reports separately. The time spent in a pass does not include the time spent in any
+  * pass started inside it, so the passes add up to the time of the build
+  */
+  enum class Pass
+  {
+    LIBRARIES,
+    CHANGE_DETECTION,
+    SCANNING,
+    ORDERING,
+    CACHE,
+    LEXING,
+    PARSING,
+    SYMBOL_TABLES,
+    RESOLUTION,
+    OPTIMISATION,
+    OUTPUT,
+    NUM_PASSES
+  };
+
+  enum class PassCounter
+  {
+    TOKENS,
+    SYMBOLS,
+    LOOKUPS,
+    INSTRUCTIONS,
+    NUM_COUNTERS
+  };
+
+  const char* getPassName(Pass pass);
+  const char* getPassCounterName(PassCounter counter);
+
+  struct PassTime
+  {
+    std::uint64_t m_wallNanoseconds = 0;
+    std::uint64_t m_cpuNanoseconds = 0;
+
+    PassTime& operator += (const PassTime& time);
+  };
+
+  struct FileTimings
+  {
+    std::string m_filePath;
+    //the whole compilation of the file, including every pass run for it
+    PassTime m_time;
+    std::uint64_t m_counts[(int)PassCounter::NUM_COUNTERS] = {};
+  };
+
+  /**
+  * What --time-passes measured during a build
+  */
+  struct PassTimings
+  {
+    PassTime m_passes[(int)Pass::NUM_PASSES];
+    std::uint64_t m_counts[(int)PassCounter::NUM_COUNTERS] = {};
+    //the files compiled, in the order they were compiled
+    std::vector<FileTimings> m_files;
+
+    /**
+    * Add the passes, counts and files measured on another thread or in another build
+    */
+    void merge(const PassTimings& timings);
+  };
+
+  /**
+  * Reads the wall clock and the CPU time used by the current thread. The clocks are only read once the stopwatch is started
+  */
+  class PassStopwatch
+  {
+  public:
+    void start();
+    PassTime getElapsedTime() const;
+
+  private:
+    PassTime m_startTime;
+  };
+
+#ifndef JACK_NO_PASS_TIMING
+  /**
+  * Returns a boolean indicating whether the compiler was built with the --time-passes instrumentation
+  */
+  inline bool isPassTimingAvailable() { return true; }
+
+  /**
+  * Records the passes and counts measured on the current thread in timings until the object is destroyed. Nothing is measured
+  * while timings is null, which is the normal state
+  */
+  class PassTimingsScope
+  {
+  public:
+    PassTimingsScope(PassTimings* timings);
+    ~PassTimingsScope();
+
+  private:
+    PassTimings* m_previousTimings;
+  };
+
+  /**
+  * Adds the time from its creation to its destruction to a pass, leaving out the time of the timers created inside it. If a
+  * counter is given, one event is counted as well
+  */
+  class ScopedPassTimer
+  {
+  public:
+    ScopedPassTimer(Pass pass);
+    ScopedPassTimer(Pass pass, PassCounter counter);
+    ~ScopedPassTimer();
+
+  private:
+    Pass m_pass;
+    PassTimings* m_timings;
+    ScopedPassTimer* m_parent;
+    PassStopwatch m_stopwatch;
+    PassTime m_childTime;
+  };
+
+  /**
+  * Measures the compilation of one file, adding it to the files of the timings recorded on the current thread once destroyed.
+  * The events counted in the meantime are counted against the file too
+  */
+  class FileTimingScope
+  {
+  public:
+    FileTimingScope(const std::string& filePath);
+    ~FileTimingScope();
+
+  private:
+    PassTimings* m_timings;
+    FileTimings* m_previousFile;
+    FileTimings m_file;
+    PassStopwatch m_stopwatch;
+  };
+
+  void countPassEvents(PassCounter counter, std::uint64_t numEvents);
+#else
+  //Without the instrumentation every timer is empty, so the compiler can remove it altogether
+
+  inline bool isPassTimingAvailable() { return false; }
+
+  class PassTimingsScope
+  {
+  public:
+    PassTimingsScope(PassTimings*) {}
+  };
+
+  class ScopedPassTimer
+  {
+  public:
+    ScopedPassTimer(Pass) {}
+    ScopedPassTimer(Pass, PassCounter) {}
+  };
+
+  class FileTimingScope
+  {
+  public:
+    FileTimingScope(const std::string&) {}
+  };
+
+  inline void countPassEvents(PassCounter, std::uint64_t) {}
+#endif
+
+  /**
+  * Return the timings as a table for the console, given the time taken by the whole build
+  */
+  std::string formatPassTimings(const PassTimings& timings, const PassTime& buildTime);
+  /**
+  * Return the timings as a JSON object on a single line, given the time taken by the whole build
+  */
+  std::string formatPassTimingsAsJson(const PassTimings& timings, const PassTime& buildTime);
+}
@@ -0,0 +1,69 @@
+#include "ProgramIndex.h"
+
+namespace JackCompiler
+{
+  ProgramIndex::ProgramIndex(const std::vector<ClassInterface>& classInterfaces)
+  {
+    std::shared_ptr<Declarations> declarations = std::make_shared<Declarations>();
+    for (const ClassInterface& classInterface : classInterfaces)
+    {
+      declarations->m_classNames.insert(classInterface.m_className);
+      //a member declared twice is reported when its class is compiled, so the first declaration is kept like a symbol table would
+      for (const VariableDeclaration& variable : classInterface.m_variables)
+        declarations->m_variables.insert({classInterface.m_className + "." + variable.m_name, {classInterface.m_className, variable.m_kind, variable.m_type, {}}});
+
+      for (const SubroutineDeclaration& subroutine : classInterface.m_subroutines)
+        declarations->m_subroutines.insert({classInterface.m_className + "." + subroutine.m_name, {classInterface.m_className, subroutine.m_kind, subroutine.m_returnType, subroutine.m_parameterTypes}});
+    }
+
+    m_declarations = declarations;
+  }
+
+  const ProgramIndex::IndexEntry* ProgramIndex::findMember(const std::unordered_map<std::string, IndexEntry>& members, const std::string& name) const
+  {
+    auto member = members.find(name);
+    if (member == members.end() || member->second.m_className == m_excludedClassName)
+      return nullptr;
+
+    return &member->second;
+  }
+
+  bool ProgramIndex::checkClassDefined(const std::string& className) const
+  {
+    return className != m_excludedClassName && m_declarations->m_classNames.count(className);
+  }
+
+  bool ProgramIndex::checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const
+  {
+    //class symbol tables never hold arguments or local variables
+    if (symbolKind == Symbol::SymbolKind::ARGUMENT || symbolKind == Symbol::SymbolKind::VAR)
+      return false;
+
+    //fields and static variables conflict with each other, as do the different kinds of subroutine
+    if (symbolKind == Symbol::SymbolKind::FIELD || symbolKind == Symbol::SymbolKind::STATIC)
+      return findMember(m_declarations->m_variables, name) != nullptr;
+
+    return findMember(m_declarations->m_subroutines, name) != nullptr;
+  }
+
+  std::pair<bool, std::string> ProgramIndex::getSymbolType(const std::string& name) const
+  {
+    //a symbol table holding the class's interface lists the variables first, so they take precedence here too
+    const IndexEntry* member = findMember(m_declarations->m_variables, name);
+    if (!member)
+      member = findMember(m_declarations->m_subroutines, name);
+    if (!member)
+      return std::pair<bool, std::string>{false, "NO SUCH SYMBOL"};
+
+    return std::pair<bool, std::string>{true, member->m_type};
+  }
+
+  const std::vector<std::string>* ProgramIndex::getParameterList(const std::string& subroutineSymbolName) const
+  {
+    const IndexEntry* member = findMember(m_declarations->m_subroutines, subroutineSymbolName);
+    if (!member)
+      return nullptr;
+
+    return &member->m_parameterList;
+  }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <unordered_map>
+
+#include "Library.h"
+#include "ClassInterface.h"
+
+namespace JackCompiler
+{
+  /**
+  * The declarations of every class in the program, built once from the class interfaces before any subroutine body is compiled.
+  * The index is never modified after it is built so the files of a program can be compiled against it on several threads at once.
+  * Unlike a library it also holds the field and static variables of each class, so lookups give the same answers as the symbol
+  * tables a serial compilation would have built
+  */
+  class ProgramIndex : public LibraryInterface
+  {
+  public:
+    ProgramIndex(const std::vector<ClassInterface>& classInterfaces);
+    /**
+    * Create a view of the index that leaves out the given class - used when compiling that class, whose own declarations are
+    * added to the symbol tables by the parser
+    */
+    ProgramIndex(const ProgramIndex& index, const std::string& excludedClassName) : m_declarations(index.m_declarations), m_excludedClassName(excludedClassName) {}
+
+    bool checkClassDefined(const std::string& className) const override;
+    bool checkSymbolExists(const std::string& name, const Symbol::SymbolKind& symbolKind) const override;
+    std::pair<bool, std::string> getSymbolType(const std::string& name) const override;
+    const std::vector<std::string>* getParameterList(const std::string& subroutineSymbolName) const override;
+
+  private:
+    struct IndexEntry
+    {
+      std::string m_className;
+      Symbol::SymbolKind m_kind;
+      std::string m_type;
+      std::vector<std::string> m_parameterList;
+    };
+
+    struct Declarations
+    {
+      std::set<std::string> m_classNames;
+      //keyed by className.memberName. A class may use the same name for a variable and a subroutine, so they are kept apart
+      std::unordered_map<std::string, IndexEntry> m_variables;
+      std::unordered_map<std::string, IndexEntry> m_subroutines;
+    };
+
+    /**
+    * Return the entry for the member with the given name, or nullptr if no class outside the excluded one declares it
+    */
+    const IndexEntry* findMember(const std::unordered_map<std::string, IndexEntry>& members, const std::string& name) const;
+
+    std::shared_ptr<const Declarations> m_declarations;
+    std::string m_excludedClassName;
+  };
+}
@@ -1,10 +1,12 @@
 #include "SymbolTable.h"
+#include "Library.h"
+#include "PassTimer.h"
 
 #include <algorithm>
 
 namespace JackCompiler
 {
-  std::map<Symbol::SymbolKind, std::string> Symbol::m_symbolKindMapping =
+  const std::map<Symbol::SymbolKind, std::string> Symbol::m_symbolKindMapping =
   {
     {Symbol::SymbolKind::ARGUMENT, "ARGUMENT"},
     {Symbol::SymbolKind::CONSTRUCTOR, "CONSTRUCTOR"},
@@ -16,8 +18,6 @@ namespace JackCompiler
     {Symbol::SymbolKind::CLASS, "CLASS"}
   };
 
-  unsigned SymbolTable::m_offsetStatic = 0;
-
   void SymbolTable::addSymbol(const std::string symbolName, const Symbol::SymbolKind& symbolKind, const std::string& symbolType)
   {
     Symbol newSymbol;
@@ -41,7 +41,7 @@ namespace JackCompiler
       break;
 
     case Symbol::SymbolKind::STATIC:
-      newSymbol.m_offset = m_offsetStatic++;
+      newSymbol.m_offset = m_offsets[(int)OffsetsIndex::STATIC]++;
       break;
 
     default:
@@ -157,6 +157,11 @@ namespace JackCompiler
     m_symbolTables.push_back(std::make_shared<SymbolTable>(SymbolTable(newSymbolTable)));
   }
 
+  void SymbolTables::addLibrary(const std::shared_ptr<const LibraryInterface>& library)
+  {
+    m_libraries.push_back(library);
+  }
+
   void SymbolTables::removeCurrentSymbolTable()
   {
     //Remove the current symbol table which is located at the end of the list
@@ -165,50 +170,69 @@ namespace JackCompiler
 
   bool SymbolTables::checkSymbolExistsInAllSymbolTables(const std::string& name, const Symbol::SymbolKind& symbolKind) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       if (symbolTable->checkSymbolExists(name, symbolKind))
         return true;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      if (library->checkSymbolExists(name, symbolKind))
+        return true;
+    }
+
     return false;
   }
 
   bool SymbolTables::checkSymbolExistsInCurrentSymbolTable(const std::string& name, const Symbol::SymbolKind& symbolKind) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     auto currentSymbolTable = m_symbolTables.back();
     return currentSymbolTable->checkSymbolExists(name, symbolKind);
   }
 
   bool SymbolTables::checkClassDefined(const std::string& className) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       if (symbolTable->getTableName() == className)
         return true;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      if (library->checkClassDefined(className))
+        return true;
+    }
+
     return false;
   }
 
   void SymbolTables::addToSymbolTables(const std::string symbolName, const Symbol::SymbolKind& symbolKind, const std::string& symbolType)
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::SYMBOLS);
     m_symbolTables.back()->addSymbol(symbolName, symbolKind, symbolType);
   }
 
   void SymbolTables::addToSymbolTables(const std::string symbolName, const Symbol::SymbolKind& symbolKind, const std::string& symbolType, const std::vector<std::string> parameterList)
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::SYMBOLS);
     m_symbolTables.back()->addSymbol(symbolName, symbolKind, symbolType, parameterList);
   }
 
   void SymbolTables::setSymbolInitialised(const std::string& name)
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES);
     for (auto symbolTable : m_symbolTables)
       symbolTable->setSymbolInitialised(name);
   }
 
   void SymbolTables::setSymbolInitialised(const std::string& name, const std::string& className)
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES);
     for (auto symbolTable : m_symbolTables)
       symbolTable->setSymbolInitialised(name);
 
@@ -222,23 +246,38 @@ namespace JackCompiler
 
   bool SymbolTables::checkSymbolInitialised(const std::string& name) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable: m_symbolTables)
     {
       if (symbolTable->checkSymbolInitialised(name))
         return true;
     }
 
+    //library subroutines are always initialised
+    for (const auto& library : m_libraries)
+    {
+      if (library->checkSymbolExists(name, Symbol::SymbolKind::FUNCTION))
+        return true;
+    }
+
     return false;
   }
 
   bool SymbolTables::checkSymbolInitialised(const std::string& name, const std::string& className) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable: m_symbolTables)
     {
       if (symbolTable->checkSymbolInitialised(name))
         return true;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      if (library->checkSymbolExists(name, Symbol::SymbolKind::FUNCTION))
+        return true;
+    }
+
     for (auto symbolTable: m_symbolTables)
     {
       if (symbolTable->checkSymbolInitialised(className + "." + name))
@@ -250,6 +289,7 @@ namespace JackCompiler
 
   std::pair<bool, std::string> SymbolTables::getSymbolType(const std::string& name) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       auto symbolTypePair = symbolTable->getSymbolType(name);
@@ -257,11 +297,19 @@ namespace JackCompiler
         return symbolTypePair;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      auto symbolTypePair = library->getSymbolType(name);
+      if (symbolTypePair.first == true)
+        return symbolTypePair;
+    }
+
     return std::pair<bool, std::string>{false, "NO SUCH SYMBOL"};
   }
 
   std::pair<bool, std::string> SymbolTables::getSymbolType(const std::string& name, const std::string& className) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       auto symbolTypePair = symbolTable->getSymbolType(name);
@@ -269,6 +317,13 @@ namespace JackCompiler
         return symbolTypePair;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      auto symbolTypePair = library->getSymbolType(name);
+      if (symbolTypePair.first == true)
+        return symbolTypePair;
+    }
+
     //check for field or static variables
 
     for (auto symbolTable : m_symbolTables)
@@ -283,6 +338,7 @@ namespace JackCompiler
 
   const std::vector<std::string>* SymbolTables::getParameterList(const std::string& subroutineSymbolName) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       const std::vector<std::string>* parameterList = symbolTable->getParameterList(subroutineSymbolName);
@@ -290,11 +346,19 @@ namespace JackCompiler
         return parameterList;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      const std::vector<std::string>* parameterList = library->getParameterList(subroutineSymbolName);
+      if (parameterList)
+        return parameterList;
+    }
+
     return nullptr;
   }
 
   const std::vector<std::string>* SymbolTables::getParameterList(const std::string& subroutineSymbolName, const std::string& className) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       const std::vector<std::string>* parameterList = symbolTable->getParameterList(subroutineSymbolName);
@@ -302,6 +366,13 @@ namespace JackCompiler
         return parameterList;
     }
 
+    for (const auto& library : m_libraries)
+    {
+      const std::vector<std::string>* parameterList = library->getParameterList(subroutineSymbolName);
+      if (parameterList)
+        return parameterList;
+    }
+
     std::string symbolWithClassName = className + "." + subroutineSymbolName;
 
     for (auto symbolTable : m_symbolTables)
@@ -316,6 +387,7 @@ namespace JackCompiler
 
   std::pair<int, Symbol::SymbolKind> SymbolTables::getOffsetAndKind(const std::string& symbolName) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       auto offsetAndKind = symbolTable->getOffsetAndKind(symbolName);
@@ -328,6 +400,7 @@ namespace JackCompiler
 
   std::pair<int, Symbol::SymbolKind> SymbolTables::getOffsetAndKind(const std::string& symbolName, const std::string& className) const
   {
+    ScopedPassTimer passTimer(Pass::SYMBOL_TABLES, PassCounter::LOOKUPS);
     for (auto symbolTable : m_symbolTables)
     {
       auto offsetAndKind = symbolTable->getOffsetAndKind(symbolName);
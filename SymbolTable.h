@@ -9,6 +9,8 @@
 
 namespace JackCompiler
 {
+  class LibraryInterface;
+
   struct Symbol
   {
     enum class SymbolKind
@@ -23,7 +25,7 @@ namespace JackCompiler
       CLASS
     };
 
-    static std::map<SymbolKind, std::string> m_symbolKindMapping;
+    static const std::map<SymbolKind, std::string> m_symbolKindMapping;
 
     Symbol() :  m_initialised(false) {}
     virtual const std::vector<std::string>* const getParameterList() const { return nullptr; }
@@ -116,16 +118,17 @@ namespace JackCompiler
     std::pair<int, Symbol::SymbolKind> getOffsetAndKind(const std::string& symbolName, const std::string& className) const;
     
 
-    static const unsigned m_numOfDifferentOffsets = 3;
+    static const unsigned m_numOfDifferentOffsets = 4;
     //used as array indexes - do not change
     enum class OffsetsIndex
     {
       ARGUMENT,
       LOCAL,
-      FIELD
+      FIELD,
+      //the vm static segment belongs to a single file, so static variables are numbered from zero in each class
+      STATIC
     };
 
-    static unsigned m_offsetStatic;
     friend std::ostream& operator << (std::ostream& out, const std::shared_ptr<SymbolTable>& symbolTable);
 
   private:
@@ -150,6 +153,10 @@ namespace JackCompiler
   public:
     void addSymbolTable(const SymbolTable& newSymbolTable);
     /**
+    * Add a library whose declarations are consulted by every lookup alongside the symbol tables
+    */
+    void addLibrary(const std::shared_ptr<const LibraryInterface>& library);
+    /**
     * Remove the current symbol table at the end of the list
     */
     void removeCurrentSymbolTable();
@@ -223,6 +230,8 @@ namespace JackCompiler
 
   private:
     std::list<std::shared_ptr<SymbolTable>> m_symbolTables;
+    //libraries are kept out of m_symbolTables so that scans over the user symbol tables never have to walk through them
+    std::vector<std::shared_ptr<const LibraryInterface>> m_libraries;
   };
 
   inline std::ostream& operator << (std::ostream& out, const SymbolTables& symbolTables)
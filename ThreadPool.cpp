@@ -0,0 +1,67 @@
+#include "ThreadPool.h"
+
+#include <thread>
+
+namespace JackCompiler
+{
+  void ThreadPool::run(std::size_t numTasks, const std::function<void(std::size_t)>& task)
+  {
+    unsigned numThreads = numTasks < m_numThreads ? (unsigned)numTasks : m_numThreads;
+    if (numThreads <= 1)
+    {
+      for (std::size_t i = 0; i < numTasks; ++i)
+        task(i);
+      return;
+    }
+
+    //neighbouring tasks go to the same thread, which keeps each thread on its own part of the list for as long as possible
+    std::vector<WorkQueue> workQueues(numThreads);
+    for (std::size_t i = 0; i < numTasks; ++i)
+      workQueues[i * numThreads / numTasks].m_tasks.push_back(i);
+
+    auto worker = [&](unsigned threadIndex)
+    {
+      std::size_t taskIndex;
+      while (takeTask(workQueues, threadIndex, taskIndex))
+        task(taskIndex);
+    };
+
+    //the calling thread does a share of the work too
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads; ++i)
+      threads.emplace_back(worker, i);
+    worker(0);
+
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+
+  bool ThreadPool::takeTask(std::vector<WorkQueue>& workQueues, unsigned threadIndex, std::size_t& taskIndex) const
+  {
+    {
+      WorkQueue& ownQueue = workQueues[threadIndex];
+      std::lock_guard<std::mutex> lock(ownQueue.m_mutex);
+      if (!ownQueue.m_tasks.empty())
+      {
+        taskIndex = ownQueue.m_tasks.front();
+        ownQueue.m_tasks.pop_front();
+        return true;
+      }
+    }
+
+    //no new tasks are ever added, so once every queue has been seen empty there is nothing left to do
+    for (std::size_t offset = 1; offset < workQueues.size(); ++offset)
+    {
+      WorkQueue& victimQueue = workQueues[(threadIndex + offset) % workQueues.size()];
+      std::lock_guard<std::mutex> lock(victimQueue.m_mutex);
+      if (!victimQueue.m_tasks.empty())
+      {
+        taskIndex = victimQueue.m_tasks.back();
+        victimQueue.m_tasks.pop_back();
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <cstddef>
+
+namespace JackCompiler
+{
+  /**
+  * Runs a batch of independent tasks on a fixed number of threads. Each thread starts with its own contiguous share of the tasks
+  * and, once that runs out, steals tasks from the back of the other threads' shares, so a few large files do not leave the
+  * remaining threads idle
+  */
+  class ThreadPool
+  {
+  public:
+    ThreadPool(unsigned numThreads) : m_numThreads(numThreads == 0 ? 1 : numThreads) {}
+    /**
+    * Call task with every index from 0 to numTasks - 1 and return once all of the calls have finished. The task must not throw
+    */
+    void run(std::size_t numTasks, const std::function<void(std::size_t)>& task);
+    unsigned getNumThreads() const { return m_numThreads; }
+
+  private:
+    struct WorkQueue
+    {
+      std::mutex m_mutex;
+      std::deque<std::size_t> m_tasks;
+    };
+
+    /**
+    * Take the next task from the front of the queue of the given thread, or steal one from the back of another queue. Returns
+    * false once every queue is empty
+    */
+    bool takeTask(std::vector<WorkQueue>& workQueues, unsigned threadIndex, std::size_t& taskIndex) const;
+
+    unsigned m_numThreads;
+  };
+}
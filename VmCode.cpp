@@ -0,0 +1,166 @@
+#include "VmCode.h"
+
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char* const s_opcodeNames[] =
+    {
+      "push",
+      "pop",
+      "add",
+      "sub",
+      "neg",
+      "eq",
+      "gt",
+      "lt",
+      "and",
+      "or",
+      "not",
+      "label",
+      "goto",
+      "if-goto",
+      "function",
+      "call",
+      "return"
+    };
+
+    const char* const s_segmentNames[] = {"", "argument", "local", "static", "constant", "this", "that", "pointer", "temp"};
+
+    bool hasName(VmOpcode opcode)
+    {
+      return opcode == VmOpcode::LABEL || opcode == VmOpcode::GOTO || opcode == VmOpcode::IF_GOTO || opcode == VmOpcode::FUNCTION || opcode == VmOpcode::CALL;
+    }
+  }
+
+  const char* getOpcodeName(VmOpcode opcode)
+  {
+    return s_opcodeNames[(int)opcode];
+  }
+
+  const char* getSegmentName(VmSegment segment)
+  {
+    return s_segmentNames[(int)segment];
+  }
+
+  std::uint32_t VmCode::internName(const std::string& name)
+  {
+    auto nameId = m_nameIds.find(name);
+    if (nameId != m_nameIds.end())
+      return nameId->second;
+
+    m_names.push_back(name);
+    m_nameIds.emplace(name, m_names.size() - 1);
+    return m_names.size() - 1;
+  }
+
+  void VmCode::appendText(std::string& text) const
+  {
+    //most instructions fit in 20 characters, so the text is rarely reallocated more than once
+    text.reserve(text.size() + m_instructions.size() * 20);
+    for (const VmInstruction& instruction : m_instructions)
+    {
+      text.append(s_opcodeNames[(int)instruction.m_opcode]);
+      if (instruction.m_opcode == VmOpcode::PUSH || instruction.m_opcode == VmOpcode::POP)
+        text.append(" ").append(s_segmentNames[(int)instruction.m_segment]).append(" ").append(std::to_string(instruction.m_operand));
+      else if (hasName(instruction.m_opcode))
+        text.append(" ").append(m_names[instruction.m_nameId]);
+      if (instruction.m_opcode == VmOpcode::FUNCTION || instruction.m_opcode == VmOpcode::CALL)
+        text.append(" ").append(std::to_string(instruction.m_operand));
+      text.push_back('\n');
+    }
+  }
+
+  std::string VmCode::toText() const
+  {
+    std::string text;
+    appendText(text);
+    return text;
+  }
+
+  bool VmCode::parseText(const std::string& text)
+  {
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+      std::istringstream words(line);
+      std::string command;
+      if (!(words >> command))
+        continue;
+
+      auto opcodeName = std::find(std::begin(s_opcodeNames), std::end(s_opcodeNames), command);
+      if (opcodeName == std::end(s_opcodeNames))
+        return false;
+
+      VmInstruction instruction {(VmOpcode)(opcodeName - std::begin(s_opcodeNames)), VmSegment::NONE, 0, 0};
+      unsigned operand = 0;
+      if (instruction.m_opcode == VmOpcode::PUSH || instruction.m_opcode == VmOpcode::POP)
+      {
+        std::string segment;
+        words >> segment >> operand;
+        auto segmentName = std::find(std::begin(s_segmentNames) + 1, std::end(s_segmentNames), segment);
+        if (segmentName == std::end(s_segmentNames))
+          return false;
+        instruction.m_segment = (VmSegment)(segmentName - std::begin(s_segmentNames));
+      }
+      else if (hasName(instruction.m_opcode))
+      {
+        std::string name;
+        if (!(words >> name))
+          return false;
+        instruction.m_nameId = internName(name);
+        if (instruction.m_opcode == VmOpcode::FUNCTION || instruction.m_opcode == VmOpcode::CALL)
+          words >> operand;
+      }
+
+      if (words.fail() || operand > 0xFFFF)
+        return false;
+      instruction.m_operand = operand;
+      m_instructions.push_back(instruction);
+    }
+    return true;
+  }
+
+  void VmCode::serialise(std::string& data) const
+  {
+    writeValue(data, m_names.size(), 4);
+    for (const std::string& name : m_names)
+      writeString(data, name);
+
+    writeValue(data, m_instructions.size(), 4);
+    for (const VmInstruction& instruction : m_instructions)
+    {
+      writeValue(data, (std::uint8_t)instruction.m_opcode, 1);
+      writeValue(data, (std::uint8_t)instruction.m_segment, 1);
+      writeValue(data, instruction.m_operand, 2);
+      writeValue(data, instruction.m_nameId, 4);
+    }
+  }
+
+  bool VmCode::deserialise(BinaryReader& reader)
+  {
+    *this = VmCode();
+    for (std::uint64_t i = reader.readValue(4); i > 0 && reader.m_valid; --i)
+      internName(reader.readString());
+
+    for (std::uint64_t i = reader.readValue(4); i > 0 && reader.m_valid; --i)
+    {
+      VmInstruction instruction;
+      instruction.m_opcode = (VmOpcode)reader.readValue(1);
+      instruction.m_segment = (VmSegment)reader.readValue(1);
+      instruction.m_operand = reader.readValue(2);
+      instruction.m_nameId = reader.readValue(4);
+      if (instruction.m_opcode >= VmOpcode::NUM_OPCODES || instruction.m_segment >= VmSegment::NUM_SEGMENTS ||
+          (hasName(instruction.m_opcode) && instruction.m_nameId >= m_names.size()))
+        reader.m_valid = false;
+      m_instructions.push_back(instruction);
+    }
+
+    return reader.m_valid;
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "BinaryData.h"
+
+namespace JackCompiler
+{
+  enum class VmOpcode : std::uint8_t
+  {
+    PUSH,
+    POP,
+    ADD,
+    SUB,
+    NEG,
+    EQ,
+    GT,
+    LT,
+    AND,
+    OR,
+    NOT,
+    LABEL,
+    GOTO,
+    IF_GOTO,
+    FUNCTION,
+    CALL,
+    RETURN,
+    NUM_OPCODES
+  };
+
+  enum class VmSegment : std::uint8_t
+  {
+    NONE,
+    ARGUMENT,
+    LOCAL,
+    STATIC,
+    CONSTANT,
+    THIS,
+    THAT,
+    POINTER,
+    TEMP,
+    NUM_SEGMENTS
+  };
+
+  /**
+  * A single vm instruction. Labels and function names are held as ids into the names of the VmCode the instruction belongs to, so
+  * every instruction is the same size and can be compared without comparing text
+  */
+  struct VmInstruction
+  {
+    VmOpcode m_opcode;
+    VmSegment m_segment;
+    //the index into the segment for push and pop, the number of local variables for function and the number of arguments for call
+    std::uint16_t m_operand;
+    //the label for label, goto and if-goto and the function for function and call
+    std::uint32_t m_nameId;
+  };
+
+  /**
+  * The vm code generated for a class, held as instructions until it is written out as text
+  */
+  class VmCode
+  {
+  public:
+    void addPush(VmSegment segment, unsigned index) { m_instructions.push_back({VmOpcode::PUSH, segment, (std::uint16_t)index, 0}); }
+    void addPop(VmSegment segment, unsigned index) { m_instructions.push_back({VmOpcode::POP, segment, (std::uint16_t)index, 0}); }
+    /**
+    * Add an instruction without operands - an arithmetic or logical command, or return
+    */
+    void addCommand(VmOpcode opcode) { m_instructions.push_back({opcode, VmSegment::NONE, 0, 0}); }
+    /**
+    * Add label, goto or if-goto
+    */
+    void addBranch(VmOpcode opcode, const std::string& label) { m_instructions.push_back({opcode, VmSegment::NONE, 0, internName(label)}); }
+    void addFunction(const std::string& functionName, unsigned numLocalVariables) { m_instructions.push_back({VmOpcode::FUNCTION, VmSegment::NONE, (std::uint16_t)numLocalVariables, internName(functionName)}); }
+    void addCall(const std::string& functionName, unsigned numArguments) { m_instructions.push_back({VmOpcode::CALL, VmSegment::NONE, (std::uint16_t)numArguments, internName(functionName)}); }
+
+    std::vector<VmInstruction>& getInstructions() { return m_instructions; }
+    const std::vector<VmInstruction>& getInstructions() const { return m_instructions; }
+    std::size_t size() const { return m_instructions.size(); }
+    /**
+    * Remove the instructions, keeping the names so that the ids of instructions added later do not change
+    */
+    void clearInstructions() { m_instructions.clear(); }
+
+    /**
+    * Return the id of a label or function name, adding it to the names if it is new
+    */
+    std::uint32_t internName(const std::string& name);
+    const std::string& getName(std::uint32_t nameId) const { return m_names[nameId]; }
+    const std::vector<std::string>& getNames() const { return m_names; }
+
+    /**
+    * Append the instructions to text in the vm language, one instruction on each line
+    */
+    void appendText(std::string& text) const;
+    std::string toText() const;
+    /**
+    * Add the instructions of text in the vm language, as written by appendText, returning false if a line is not a valid instruction
+    */
+    bool parseText(const std::string& text);
+    /**
+    * Append the instructions and names to data in a compact binary format
+    */
+    void serialise(std::string& data) const;
+    /**
+    * Read code written by serialise, returning false if it is not well formed
+    */
+    bool deserialise(BinaryReader& reader);
+
+  private:
+    std::vector<VmInstruction> m_instructions;
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, std::uint32_t> m_nameIds;
+  };
+
+  const char* getOpcodeName(VmOpcode opcode);
+  const char* getSegmentName(VmSegment segment);
+}
@@ -0,0 +1,893 @@
+#include "VmOptimiser.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <initializer_list>
+
+#include "PassTimer.h"
+
+namespace JackCompiler
+{
+  namespace
+  {
+    const char* const s_optimisationPassNames[] = {"constant folding", "tail calls", "strength reduction", "peephole", "dead code", "labels"};
+
+    /**
+    * Wrap a value around to the 16 bit two's complement range of a Hack word
+    */
+    int toWord(int value)
+    {
+      value &= 0xFFFF;
+      return value >= 0x8000 ? value - 0x10000 : value;
+    }
+
+    /**
+    * Returns a boolean indicating whether the instructions ending just before end push a constant, setting its value and the number
+    * of instructions pushing it. A constant is pushed by push constant, optionally followed by neg or not
+    */
+    bool readConstant(const std::vector<VmInstruction>& code, std::size_t end, int& value, std::size_t& length)
+    {
+      if (end == 0)
+        return false;
+
+      const VmInstruction& last = code[end - 1];
+      if (last.m_opcode == VmOpcode::PUSH && last.m_segment == VmSegment::CONSTANT)
+      {
+        value = last.m_operand;
+        length = 1;
+        return true;
+      }
+
+      if (end < 2 || (last.m_opcode != VmOpcode::NEG && last.m_opcode != VmOpcode::NOT) || code[end - 2].m_opcode != VmOpcode::PUSH ||
+          code[end - 2].m_segment != VmSegment::CONSTANT)
+        return false;
+      value = toWord(last.m_opcode == VmOpcode::NEG ? -code[end - 2].m_operand : ~code[end - 2].m_operand);
+      length = 2;
+      return true;
+    }
+
+    /**
+    * Return the number of instructions appendConstant uses to push the value
+    */
+    std::size_t getConstantLength(int value)
+    {
+      return value >= 0 ? 1 : 2;
+    }
+
+    /**
+    * Append the shortest instructions pushing the value. A constant can only be from 0 to 32767, so a negative value is negated, apart
+    * from -32768 which is inverted
+    */
+    void appendConstant(std::vector<VmInstruction>& code, int value)
+    {
+      if (value >= 0)
+        code.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, (std::uint16_t)value, 0});
+      else if (value == -32768)
+      {
+        code.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, 32767, 0});
+        code.push_back({VmOpcode::NOT, VmSegment::NONE, 0, 0});
+      }
+      else
+      {
+        code.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, (std::uint16_t)-value, 0});
+        code.push_back({VmOpcode::NEG, VmSegment::NONE, 0, 0});
+      }
+    }
+
+    /**
+    * Returns a boolean indicating whether the code ends with instructions with the given opcodes
+    */
+    bool endsWith(const std::vector<VmInstruction>& code, std::initializer_list<VmOpcode> opcodes)
+    {
+      if (code.size() < opcodes.size())
+        return false;
+
+      auto instruction = code.end() - opcodes.size();
+      for (VmOpcode opcode : opcodes)
+      {
+        if ((instruction++)->m_opcode != opcode)
+          return false;
+      }
+      return true;
+    }
+
+    /**
+    * What a rewrite rule can see besides the code it rewrites
+    */
+    struct RewriteContext
+    {
+      //holds the names of the labels and functions of the code
+      const VmCode& m_code;
+      OptimisationStatistics& m_statistics;
+    };
+
+    bool isCallTo(const VmInstruction& instruction, const RewriteContext& context, const char* functionName, unsigned numArguments)
+    {
+      return instruction.m_opcode == VmOpcode::CALL && instruction.m_operand == numArguments && context.m_code.getName(instruction.m_nameId) == functionName;
+    }
+
+    /*
+      The constant folding rules. Each looks at the end of the code, rewriting it and returning true if it matches
+    */
+
+    bool foldUnaryOperation(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      int value;
+      std::size_t length;
+      if (code.empty() || (code.back().m_opcode != VmOpcode::NEG && code.back().m_opcode != VmOpcode::NOT) || !readConstant(code, code.size() - 1, value, length))
+        return false;
+
+      //a negative constant is itself pushed with neg or not, so it is only rewritten if that makes it shorter
+      int result = toWord(code.back().m_opcode == VmOpcode::NEG ? -value : ~value);
+      if (getConstantLength(result) >= length + 1)
+        return false;
+
+      code.resize(code.size() - length - 1);
+      appendConstant(code, result);
+      return true;
+    }
+
+    bool foldBinaryOperation(std::vector<VmInstruction>& code, RewriteContext& context)
+    {
+      if (code.empty())
+        return false;
+
+      const VmInstruction operation = code.back();
+      bool isMultiply = isCallTo(operation, context, "Math.multiply", 2);
+      bool isDivide = isCallTo(operation, context, "Math.divide", 2);
+      if (!isMultiply && !isDivide && (operation.m_opcode < VmOpcode::ADD || operation.m_opcode > VmOpcode::OR || operation.m_opcode == VmOpcode::NEG ||
+          operation.m_opcode == VmOpcode::NOT))
+        return false;
+
+      int left, right;
+      std::size_t leftLength, rightLength;
+      if (!readConstant(code, code.size() - 1, right, rightLength) || !readConstant(code, code.size() - 1 - rightLength, left, leftLength))
+        return false;
+
+      //Math.divide truncates towards zero. Dividing by zero is left to report its error at run time, and -32768 has no magnitude the
+      //library can divide
+      if (isDivide && (right == 0 || left == -32768 || right == -32768))
+        return false;
+
+      int result;
+      if (isMultiply)
+        result = left * right;
+      else if (isDivide)
+        result = left / right;
+      else if (operation.m_opcode == VmOpcode::ADD)
+        result = left + right;
+      else if (operation.m_opcode == VmOpcode::SUB)
+        result = left - right;
+      else if (operation.m_opcode == VmOpcode::AND)
+        result = left & right;
+      else if (operation.m_opcode == VmOpcode::OR)
+        result = left | right;
+      //comparisons give -1 for true and 0 for false
+      else if (operation.m_opcode == VmOpcode::EQ)
+        result = left == right ? -1 : 0;
+      else if (operation.m_opcode == VmOpcode::GT)
+        result = left > right ? -1 : 0;
+      else
+        result = left < right ? -1 : 0;
+
+      if (isMultiply || isDivide)
+        ++context.m_statistics.m_mathCallsRemoved;
+      code.resize(code.size() - 1 - rightLength - leftLength);
+      appendConstant(code, toWord(result));
+      return true;
+    }
+
+    bool removeZeroOperand(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      if (!endsWith(code, {VmOpcode::PUSH, VmOpcode::ADD}) && !endsWith(code, {VmOpcode::PUSH, VmOpcode::SUB}) && !endsWith(code, {VmOpcode::PUSH, VmOpcode::OR}))
+        return false;
+      if (code[code.size() - 2].m_segment != VmSegment::CONSTANT || code[code.size() - 2].m_operand != 0)
+        return false;
+
+      code.resize(code.size() - 2);
+      return true;
+    }
+
+    /*
+      The strength reduction rules
+    */
+
+    //the most instructions a multiplication is replaced with, which allows multiplying by up to 1024 with doubling alone
+    const std::size_t s_maxMultiplicationLength = 40;
+
+    /**
+    * Returns a boolean indicating whether the instruction pushes a value that can be pushed again by repeating it. Temp is left out
+    * as the multiplications use it themselves
+    */
+    bool isRepeatablePush(const VmInstruction& instruction)
+    {
+      return instruction.m_opcode == VmOpcode::PUSH && instruction.m_segment != VmSegment::CONSTANT && instruction.m_segment != VmSegment::TEMP;
+    }
+
+    /**
+    * Append code multiplying the value on the top of the stack, which operand pushes again, by a factor other than 0. The factor is
+    * built from its highest bit down, doubling for each bit and adding the operand for each bit that is set. Returns false if the
+    * code is longer than the call it replaces is worth
+    */
+    bool appendMultiplication(std::vector<VmInstruction>& code, const VmInstruction& operand, int factor)
+    {
+      std::size_t start = code.size();
+      unsigned magnitude = factor < 0 ? -factor : factor;
+      int bit = 15;
+      while ((magnitude >> bit & 1) == 0)
+        --bit;
+
+      for (--bit; bit >= 0; --bit)
+      {
+        //the value can only be doubled by storing it, apart from the operand itself
+        if (code.size() == start)
+          code.push_back(operand);
+        else
+        {
+          code.push_back({VmOpcode::POP, VmSegment::TEMP, 2, 0});
+          code.push_back({VmOpcode::PUSH, VmSegment::TEMP, 2, 0});
+          code.push_back({VmOpcode::PUSH, VmSegment::TEMP, 2, 0});
+        }
+        code.push_back({VmOpcode::ADD, VmSegment::NONE, 0, 0});
+
+        if ((magnitude >> bit & 1) != 0)
+        {
+          code.push_back(operand);
+          code.push_back({VmOpcode::ADD, VmSegment::NONE, 0, 0});
+        }
+      }
+
+      if (factor < 0)
+        code.push_back({VmOpcode::NEG, VmSegment::NONE, 0, 0});
+      return code.size() - start <= s_maxMultiplicationLength;
+    }
+
+    bool reduceMultiplication(std::vector<VmInstruction>& code, RewriteContext& context)
+    {
+      if (code.empty() || !isCallTo(code.back(), context, "Math.multiply", 2))
+        return false;
+
+      const std::size_t call = code.size() - 1;
+      int factor;
+      std::size_t length;
+      std::size_t keep;
+      VmInstruction operand;
+      std::vector<VmInstruction> replacement;
+      if (readConstant(code, call, factor, length) && call > length)
+      {
+        //the constant is the second argument, so the first is left where it is and stored if it cannot be pushed again
+        keep = call - length;
+        if (isRepeatablePush(code[keep - 1]))
+        {
+          operand = code[keep - 1];
+          if (factor == 0)
+          {
+            --keep;
+            replacement.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, 0, 0});
+          }
+        }
+        else if (factor == 0)
+        {
+          //the first argument may call a subroutine, so it is still evaluated
+          replacement.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, 0, 0});
+          replacement.push_back({VmOpcode::AND, VmSegment::NONE, 0, 0});
+        }
+        else
+        {
+          operand = {VmOpcode::PUSH, VmSegment::TEMP, 1, 0};
+          replacement.push_back({VmOpcode::POP, VmSegment::TEMP, 1, 0});
+          replacement.push_back(operand);
+        }
+      }
+      else if (call >= 2 && isRepeatablePush(code[call - 1]) && readConstant(code, call - 1, factor, length))
+      {
+        //the constant is the first argument and the second a single push, which is moved in front of it
+        operand = code[call - 1];
+        keep = call - 1 - length;
+        replacement.push_back(factor == 0 ? VmInstruction {VmOpcode::PUSH, VmSegment::CONSTANT, 0, 0} : operand);
+      }
+      else
+        return false;
+
+      if (factor != 0 && !appendMultiplication(replacement, operand, factor))
+        return false;
+
+      ++context.m_statistics.m_mathCallsRemoved;
+      code.resize(keep);
+      code.insert(code.end(), replacement.begin(), replacement.end());
+      return true;
+    }
+
+    bool reduceDivision(std::vector<VmInstruction>& code, RewriteContext& context)
+    {
+      //The vm has no shift, and dividing a negative number by a power of two rounds towards zero where halving with an and would round
+      //down, so only dividing by 1 and -1 is cheaper without the call
+      int divisor;
+      std::size_t length;
+      if (code.empty() || !isCallTo(code.back(), context, "Math.divide", 2) || !readConstant(code, code.size() - 1, divisor, length) ||
+          (divisor != 1 && divisor != -1) || code.size() == length + 1)
+        return false;
+
+      ++context.m_statistics.m_mathCallsRemoved;
+      code.resize(code.size() - 1 - length);
+      if (divisor == -1)
+        code.push_back({VmOpcode::NEG, VmSegment::NONE, 0, 0});
+      return true;
+    }
+
+    /*
+      The peephole rules
+    */
+
+    bool removeDoubleNot(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      if (!endsWith(code, {VmOpcode::NOT, VmOpcode::NOT}))
+        return false;
+
+      code.resize(code.size() - 2);
+      return true;
+    }
+
+    bool removePushPopRoundTrip(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      if (!endsWith(code, {VmOpcode::PUSH, VmOpcode::POP}) || code[code.size() - 2].m_segment != code.back().m_segment ||
+          code[code.size() - 2].m_operand != code.back().m_operand)
+        return false;
+
+      code.resize(code.size() - 2);
+      return true;
+    }
+
+    bool foldConstantBranch(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      int value;
+      std::size_t length;
+      if (code.empty() || code.back().m_opcode != VmOpcode::IF_GOTO || !readConstant(code, code.size() - 1, value, length))
+        return false;
+
+      VmInstruction branch = code.back();
+      branch.m_opcode = VmOpcode::GOTO;
+      code.resize(code.size() - 1 - length);
+      if (value != 0)
+        code.push_back(branch);
+      return true;
+    }
+
+    /**
+    * Branching on the negated condition the other way is only the same for a condition of 0 or -1. Anything else, such as true, which
+    * is 1, is still nonzero once negated. So the condition has to come from a comparison. A constant condition is folded before this
+    */
+    bool invertNegatedBranch(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      if (!endsWith(code, {VmOpcode::NOT, VmOpcode::IF_GOTO, VmOpcode::GOTO, VmOpcode::LABEL}) || code[code.size() - 3].m_nameId != code.back().m_nameId ||
+          code.size() < 5)
+        return false;
+      VmOpcode condition = code[code.size() - 5].m_opcode;
+      if (condition != VmOpcode::EQ && condition != VmOpcode::GT && condition != VmOpcode::LT)
+        return false;
+
+      VmInstruction label = code.back();
+      VmInstruction branch = code[code.size() - 2];
+      branch.m_opcode = VmOpcode::IF_GOTO;
+      code.resize(code.size() - 4);
+      code.push_back(branch);
+      code.push_back(label);
+      return true;
+    }
+
+    bool removeJumpToNextLabel(std::vector<VmInstruction>& code, RewriteContext&)
+    {
+      if (code.empty() || code.back().m_opcode != VmOpcode::LABEL)
+        return false;
+
+      //the jump may be followed by several labels, any of which it can be jumping to
+      std::size_t jump = code.size() - 1;
+      while (jump > 0 && code[jump].m_opcode == VmOpcode::LABEL)
+        --jump;
+      if (code[jump].m_opcode != VmOpcode::GOTO && code[jump].m_opcode != VmOpcode::IF_GOTO)
+        return false;
+
+      bool jumpsToNextLabel = false;
+      for (std::size_t label = jump + 1; label < code.size(); ++label)
+        jumpsToNextLabel = jumpsToNextLabel || code[label].m_nameId == code[jump].m_nameId;
+      if (!jumpsToNextLabel)
+        return false;
+
+      //a conditional jump still has to take its condition off the stack
+      if (code[jump].m_opcode == VmOpcode::IF_GOTO)
+        code[jump] = {VmOpcode::POP, VmSegment::TEMP, 0, 0};
+      else
+        code.erase(code.begin() + jump);
+      return true;
+    }
+
+    struct RewriteRule
+    {
+      const char* m_description;
+      bool (*m_apply)(std::vector<VmInstruction>& code, RewriteContext& context);
+    };
+
+    const RewriteRule s_constantFoldingRules[] =
+    {
+      {"constant, neg or not -> constant", foldUnaryOperation},
+      {"constant, constant, operator or Math.multiply or Math.divide -> constant", foldBinaryOperation},
+      {"push constant 0, add or sub or or -> nothing", removeZeroOperand}
+    };
+
+    const RewriteRule s_strengthReductionRules[] =
+    {
+      {"x, constant, call Math.multiply 2 -> additions and doublings of x", reduceMultiplication},
+      {"x, push constant 1, optionally neg, call Math.divide 2 -> x, optionally neg", reduceDivision}
+    };
+
+    const RewriteRule s_peepholeRules[] =
+    {
+      {"not, not -> nothing", removeDoubleNot},
+      {"push x, pop x -> nothing", removePushPopRoundTrip},
+      {"constant, if-goto L -> goto L, or nothing if never taken", foldConstantBranch},
+      {"eq or gt or lt, not, if-goto A, goto B, label A -> eq or gt or lt, if-goto B, label A", invertNegatedBranch},
+      {"goto L or if-goto L, label ..., label L -> label ..., label L", removeJumpToNextLabel}
+    };
+
+    /**
+    * Return the code with the rules applied. Every rule only looks at the end of the rewritten code, so rewriting the end again after
+    * each rule that applies catches the patterns that a rewrite uncovers as well
+    */
+    template <std::size_t numRules>
+    std::vector<VmInstruction> applyRules(const std::vector<VmInstruction>& code, const RewriteRule (&rules)[numRules], RewriteContext& context)
+    {
+      std::vector<VmInstruction> rewritten;
+      rewritten.reserve(code.size());
+      for (const VmInstruction& instruction : code)
+      {
+        rewritten.push_back(instruction);
+        bool applied = true;
+        while (applied)
+        {
+          applied = false;
+          for (const RewriteRule& rule : rules)
+          {
+            if (rule.m_apply(rewritten, context))
+            {
+              applied = true;
+              break;
+            }
+          }
+        }
+      }
+      return rewritten;
+    }
+
+    /**
+    * Apply the rules of a pass to the code of the subroutine starting at start, counting the instructions going into and out of it
+    */
+    template <std::size_t numRules>
+    void runRules(VmCode& code, std::size_t start, OptimisationPass pass, const RewriteRule (&rules)[numRules], OptimisationStatistics& statistics)
+    {
+      std::vector<VmInstruction>& instructions = code.getInstructions();
+      statistics.m_instructionsBefore[(int)pass] += instructions.size() - start;
+
+      RewriteContext context {code, statistics};
+      std::vector<VmInstruction> optimised = applyRules(std::vector<VmInstruction>(instructions.begin() + start, instructions.end()), rules, context);
+
+      instructions.resize(start);
+      instructions.insert(instructions.end(), optimised.begin(), optimised.end());
+      statistics.m_instructionsAfter[(int)pass] += optimised.size();
+    }
+
+    /**
+    * Remove the instructions of the subroutine that cannot be reached by following the jumps from its first instruction, returning
+    * false if there were none
+    */
+    bool removeUnreachableCode(std::vector<VmInstruction>& code)
+    {
+      //the labels are numbered across the class, so each label of the subroutine is only declared once
+      std::unordered_map<std::uint32_t, std::size_t> labelIndices;
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        if (code[i].m_opcode == VmOpcode::LABEL)
+          labelIndices.emplace(code[i].m_nameId, i);
+      }
+
+      std::vector<bool> reachable(code.size(), false);
+      std::vector<std::size_t> toVisit {0};
+      while (!toVisit.empty())
+      {
+        std::size_t i = toVisit.back();
+        toVisit.pop_back();
+        //each path is followed until it reaches an instruction already visited
+        for (; i < code.size() && !reachable[i]; ++i)
+        {
+          reachable[i] = true;
+          const VmInstruction& instruction = code[i];
+          if (instruction.m_opcode == VmOpcode::GOTO || instruction.m_opcode == VmOpcode::IF_GOTO)
+          {
+            auto labelIndex = labelIndices.find(instruction.m_nameId);
+            if (labelIndex != labelIndices.end())
+              toVisit.push_back(labelIndex->second);
+          }
+          if (instruction.m_opcode == VmOpcode::GOTO || instruction.m_opcode == VmOpcode::RETURN)
+            break;
+        }
+      }
+
+      if (std::find(reachable.begin(), reachable.end(), false) == reachable.end())
+        return false;
+
+      std::size_t numReachable = 0;
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        if (reachable[i])
+          code[numReachable++] = code[i];
+      }
+      code.resize(numReachable);
+      return true;
+    }
+
+    bool isJump(const VmInstruction& instruction)
+    {
+      return instruction.m_opcode == VmOpcode::GOTO || instruction.m_opcode == VmOpcode::IF_GOTO;
+    }
+
+    /**
+    * Make every jump go to the first of the labels declared together with its label, skipping over labels followed by a goto, and
+    * remove the labels that are then not jumped to. Returns false if nothing changed
+    */
+    bool simplifyLabels(std::vector<VmInstruction>& code)
+    {
+      //labels declared one after another are the same place, so each is replaced by the first. A jump to that place ends up at the
+      //first instruction after them
+      std::unordered_map<std::uint32_t, std::uint32_t> firstLabels;
+      std::unordered_map<std::uint32_t, std::size_t> targetIndices;
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        if (code[i].m_opcode != VmOpcode::LABEL)
+          continue;
+
+        std::uint32_t firstLabel = i > 0 && code[i - 1].m_opcode == VmOpcode::LABEL ? firstLabels[code[i - 1].m_nameId] : code[i].m_nameId;
+        firstLabels[code[i].m_nameId] = firstLabel;
+        targetIndices[firstLabel] = i + 1;
+      }
+
+      bool changed = false;
+      std::unordered_map<std::uint32_t, unsigned> numJumps;
+      for (VmInstruction& instruction : code)
+      {
+        if (!isJump(instruction) || firstLabels.count(instruction.m_nameId) == 0)
+          continue;
+
+        //a jump to a goto can go straight to where the goto goes. The chain is cut short if it loops, as a loop of gotos never ends
+        std::uint32_t label = firstLabels[instruction.m_nameId];
+        for (std::size_t step = 0; step < code.size(); ++step)
+        {
+          std::size_t targetIndex = targetIndices[label];
+          if (targetIndex == code.size() || code[targetIndex].m_opcode != VmOpcode::GOTO || firstLabels.count(code[targetIndex].m_nameId) == 0 ||
+              firstLabels[code[targetIndex].m_nameId] == label)
+            break;
+          label = firstLabels[code[targetIndex].m_nameId];
+        }
+
+        changed = changed || label != instruction.m_nameId;
+        instruction.m_nameId = label;
+        ++numJumps[label];
+      }
+
+      std::size_t numKept = 0;
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        if (code[i].m_opcode != VmOpcode::LABEL || numJumps.count(code[i].m_nameId) != 0)
+          code[numKept++] = code[i];
+      }
+      changed = changed || numKept != code.size();
+      code.resize(numKept);
+      return changed;
+    }
+
+    /**
+    * Give the labels of the subroutine the shortest names, numbering them from 0 in the order they are declared
+    */
+    void renumberLabels(std::vector<VmInstruction>& code, VmCode& names)
+    {
+      std::unordered_map<std::uint32_t, std::uint32_t> newNameIds;
+      for (const VmInstruction& instruction : code)
+      {
+        if (instruction.m_opcode == VmOpcode::LABEL)
+          newNameIds.emplace(instruction.m_nameId, names.internName("L" + std::to_string(newNameIds.size())));
+      }
+
+      for (VmInstruction& instruction : code)
+      {
+        if (instruction.m_opcode == VmOpcode::LABEL || isJump(instruction))
+        {
+          auto newNameId = newNameIds.find(instruction.m_nameId);
+          if (newNameId != newNameIds.end())
+            instruction.m_nameId = newNameId->second;
+        }
+      }
+    }
+
+    /**
+    * Replace the local variables of the subroutine that are set to a constant once, before any label or jump and before anything reads
+    * them, with that constant. Such a variable holds the constant whenever it is read, so the variable is not set at all. Returns
+    * false if there were none
+    */
+    bool propagateConstantLocals(std::vector<VmInstruction>& code)
+    {
+      struct LocalUse
+      {
+        unsigned m_numStores = 0;
+        std::size_t m_storeIndex = 0;
+        bool m_readBeforeStore = false;
+      };
+
+      //Nothing can jump back to before the first label, so a store before it runs exactly once, ahead of every instruction after it
+      std::size_t firstLabelIndex = code.size();
+      std::vector<LocalUse> localUses;
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        const VmInstruction& instruction = code[i];
+        if (firstLabelIndex == code.size() && (instruction.m_opcode == VmOpcode::LABEL || instruction.m_opcode == VmOpcode::GOTO || instruction.m_opcode == VmOpcode::IF_GOTO))
+          firstLabelIndex = i;
+        if ((instruction.m_opcode != VmOpcode::PUSH && instruction.m_opcode != VmOpcode::POP) || instruction.m_segment != VmSegment::LOCAL)
+          continue;
+
+        if (instruction.m_operand >= localUses.size())
+          localUses.resize(instruction.m_operand + 1);
+        LocalUse& localUse = localUses[instruction.m_operand];
+        if (instruction.m_opcode == VmOpcode::PUSH)
+          localUse.m_readBeforeStore = localUse.m_readBeforeStore || localUse.m_numStores == 0;
+        else if (localUse.m_numStores++ == 0)
+          localUse.m_storeIndex = i;
+      }
+
+      std::vector<bool> isConstant(localUses.size(), false);
+      std::vector<int> values(localUses.size(), 0);
+      std::vector<bool> removed(code.size(), false);
+      bool propagated = false;
+      for (std::size_t local = 0; local < localUses.size(); ++local)
+      {
+        const LocalUse& localUse = localUses[local];
+        std::size_t length;
+        //a negative constant takes two instructions to push, so reading it from the variable is as short
+        if (localUse.m_numStores != 1 || localUse.m_readBeforeStore || localUse.m_storeIndex >= firstLabelIndex ||
+            !readConstant(code, localUse.m_storeIndex, values[local], length) || values[local] < 0)
+          continue;
+
+        isConstant[local] = true;
+        propagated = true;
+        for (std::size_t i = localUse.m_storeIndex - length; i <= localUse.m_storeIndex; ++i)
+          removed[i] = true;
+      }
+      if (!propagated)
+        return false;
+
+      std::vector<VmInstruction> rewritten;
+      rewritten.reserve(code.size());
+      for (std::size_t i = 0; i < code.size(); ++i)
+      {
+        const VmInstruction& instruction = code[i];
+        if (removed[i])
+          continue;
+        if (instruction.m_opcode == VmOpcode::PUSH && instruction.m_segment == VmSegment::LOCAL && isConstant[instruction.m_operand])
+          appendConstant(rewritten, values[instruction.m_operand]);
+        else
+          rewritten.push_back(instruction);
+      }
+      code.swap(rewritten);
+      return true;
+    }
+  }
+
+  const char* getOptimisationPassName(OptimisationPass pass)
+  {
+    return s_optimisationPassNames[(int)pass];
+  }
+
+  void OptimisationStatistics::merge(const OptimisationStatistics& statistics)
+  {
+    for (int i = 0; i < (int)OptimisationPass::NUM_OPTIMISATION_PASSES; ++i)
+    {
+      m_instructionsBefore[i] += statistics.m_instructionsBefore[i];
+      m_instructionsAfter[i] += statistics.m_instructionsAfter[i];
+    }
+    m_mathCallsRemoved += statistics.m_mathCallsRemoved;
+    m_tailCallsRemoved += statistics.m_tailCallsRemoved;
+    m_stringLiterals += statistics.m_stringLiterals;
+    m_pooledStrings += statistics.m_pooledStrings;
+    m_stringInstructionsBefore += statistics.m_stringInstructionsBefore;
+    m_stringInstructionsAfter += statistics.m_stringInstructionsAfter;
+    m_stringCallsBefore += statistics.m_stringCallsBefore;
+    m_stringCallsAfter += statistics.m_stringCallsAfter;
+  }
+
+  void OptimisationStatistics::serialise(std::string& data) const
+  {
+    writeValue(data, (int)OptimisationPass::NUM_OPTIMISATION_PASSES, 1);
+    for (int i = 0; i < (int)OptimisationPass::NUM_OPTIMISATION_PASSES; ++i)
+    {
+      writeValue(data, m_instructionsBefore[i], 8);
+      writeValue(data, m_instructionsAfter[i], 8);
+    }
+    writeValue(data, m_mathCallsRemoved, 8);
+    writeValue(data, m_tailCallsRemoved, 8);
+    for (std::uint64_t value : {m_stringLiterals, m_pooledStrings, m_stringInstructionsBefore, m_stringInstructionsAfter, m_stringCallsBefore, m_stringCallsAfter})
+      writeValue(data, value, 8);
+  }
+
+  bool OptimisationStatistics::deserialise(BinaryReader& reader)
+  {
+    if (reader.readValue(1) != (int)OptimisationPass::NUM_OPTIMISATION_PASSES)
+      reader.m_valid = false;
+    for (int i = 0; i < (int)OptimisationPass::NUM_OPTIMISATION_PASSES && reader.m_valid; ++i)
+    {
+      m_instructionsBefore[i] = reader.readValue(8);
+      m_instructionsAfter[i] = reader.readValue(8);
+    }
+    m_mathCallsRemoved = reader.readValue(8);
+    m_tailCallsRemoved = reader.readValue(8);
+    for (std::uint64_t* value : {&m_stringLiterals, &m_pooledStrings, &m_stringInstructionsBefore, &m_stringInstructionsAfter, &m_stringCallsBefore, &m_stringCallsAfter})
+      *value = reader.readValue(8);
+    return reader.m_valid;
+  }
+
+  std::string formatOptimisationStatistics(const OptimisationStatistics& statistics)
+  {
+    std::ostringstream text;
+    text << "Optimisation statistics:" << '\n';
+    for (int i = 0; i < (int)OptimisationPass::NUM_OPTIMISATION_PASSES; ++i)
+    {
+      //strength reduction replaces a call with several cheaper instructions, so a pass can add instructions
+      std::uint64_t before = statistics.m_instructionsBefore[i];
+      std::uint64_t after = statistics.m_instructionsAfter[i];
+      text << "  " << s_optimisationPassNames[i] << ": " << before << " instructions before, " << after << " after, " <<
+              (before >= after ? before - after : after - before) << (before >= after ? " removed" : " added") << '\n';
+    }
+    text << "  Math.multiply and Math.divide calls removed: " << statistics.m_mathCallsRemoved << '\n';
+    text << "  tail calls turned into jumps: " << statistics.m_tailCallsRemoved << '\n';
+    if (statistics.m_stringLiterals != 0)
+    {
+      text << "  string pooling: " << statistics.m_stringLiterals << " literals sharing " << statistics.m_pooledStrings << " strings, " <<
+              statistics.m_stringInstructionsBefore << " instructions before, " << statistics.m_stringInstructionsAfter << " after, " <<
+              statistics.m_stringCallsBefore << " calls before, " << statistics.m_stringCallsAfter << " after" << '\n';
+    }
+    return text.str();
+  }
+
+  void VmOptimiser::optimiseSubroutine(VmCode& code, std::size_t start)
+  {
+    ScopedPassTimer passTimer(Pass::OPTIMISATION);
+    runConstantFolding(code, start);
+    runTailCallElimination(code, start);
+    runRules(code, start, OptimisationPass::STRENGTH_REDUCTION, s_strengthReductionRules, m_statistics);
+    runRules(code, start, OptimisationPass::PEEPHOLE, s_peepholeRules, m_statistics);
+    runDeadCodeElimination(code, start);
+    runLabelSimplification(code, start);
+  }
+
+  void VmOptimiser::runConstantFolding(VmCode& code, std::size_t start)
+  {
+    std::vector<VmInstruction>& instructions = code.getInstructions();
+    m_statistics.m_instructionsBefore[(int)OptimisationPass::CONSTANT_FOLDING] += instructions.size() - start;
+
+    //A propagated variable can make the expression stored in another variable constant, so the two are repeated until nothing changes
+    RewriteContext context {code, m_statistics};
+    std::vector<VmInstruction> optimised = applyRules(std::vector<VmInstruction>(instructions.begin() + start, instructions.end()), s_constantFoldingRules, context);
+    while (propagateConstantLocals(optimised))
+      optimised = applyRules(optimised, s_constantFoldingRules, context);
+
+    instructions.resize(start);
+    instructions.insert(instructions.end(), optimised.begin(), optimised.end());
+    m_statistics.m_instructionsAfter[(int)OptimisationPass::CONSTANT_FOLDING] += optimised.size();
+  }
+
+  void VmOptimiser::runDeadCodeElimination(VmCode& code, std::size_t start)
+  {
+    std::vector<VmInstruction>& instructions = code.getInstructions();
+    m_statistics.m_instructionsBefore[(int)OptimisationPass::DEAD_CODE] += instructions.size() - start;
+
+    RewriteContext context {code, m_statistics};
+    std::vector<VmInstruction> optimised(instructions.begin() + start, instructions.end());
+    while (removeUnreachableCode(optimised))
+      optimised = applyRules(optimised, s_peepholeRules, context);
+
+    instructions.resize(start);
+    instructions.insert(instructions.end(), optimised.begin(), optimised.end());
+    m_statistics.m_instructionsAfter[(int)OptimisationPass::DEAD_CODE] += optimised.size();
+  }
+
+  void VmOptimiser::runLabelSimplification(VmCode& code, std::size_t start)
+  {
+    std::vector<VmInstruction>& instructions = code.getInstructions();
+    m_statistics.m_instructionsBefore[(int)OptimisationPass::LABELS] += instructions.size() - start;
+
+    //Removing a label can leave the code after a goto unreachable, and a jump that now goes to the next instruction can be dropped
+    RewriteContext context {code, m_statistics};
+    std::vector<VmInstruction> optimised(instructions.begin() + start, instructions.end());
+    while (simplifyLabels(optimised))
+    {
+      removeUnreachableCode(optimised);
+      optimised = applyRules(optimised, s_peepholeRules, context);
+    }
+    renumberLabels(optimised, code);
+
+    instructions.resize(start);
+    instructions.insert(instructions.end(), optimised.begin(), optimised.end());
+    m_statistics.m_instructionsAfter[(int)OptimisationPass::LABELS] += optimised.size();
+  }
+
+  void VmOptimiser::runTailCallElimination(VmCode& code, std::size_t start)
+  {
+    std::vector<VmInstruction>& instructions = code.getInstructions();
+    m_statistics.m_instructionsBefore[(int)OptimisationPass::TAIL_CALLS] += instructions.size() - start;
+
+    //A constructor allocates its object before anything else, and the position of the allocation's size may still be patched, so
+    //constructors are left as they are
+    const VmInstruction function = instructions[start];
+    bool isConstructor = instructions.size() > start + 2 && instructions[start + 2].m_opcode == VmOpcode::CALL && code.getName(instructions[start + 2].m_nameId) == "Memory.alloc";
+    std::vector<std::size_t> tailCalls;
+    for (std::size_t i = start + 1; i + 1 < instructions.size() && !isConstructor; ++i)
+    {
+      if (instructions[i].m_opcode == VmOpcode::CALL && instructions[i].m_nameId == function.m_nameId && instructions[i + 1].m_opcode == VmOpcode::RETURN)
+        tailCalls.push_back(i);
+    }
+
+    if (!tailCalls.empty())
+    {
+      //A call starts with every local variable set to 0. A local that is never read, or always set before it is read in the code that
+      //runs before the first branch, does not need clearing
+      std::vector<bool> setBeforeRead(function.m_operand, true);
+      for (std::size_t i = start + 1; i < instructions.size(); ++i)
+      {
+        if (instructions[i].m_opcode == VmOpcode::PUSH && instructions[i].m_segment == VmSegment::LOCAL && instructions[i].m_operand < function.m_operand)
+          setBeforeRead[instructions[i].m_operand] = false;
+      }
+      std::vector<bool> seen(function.m_operand, false);
+      for (std::size_t i = start + 1; i < instructions.size() && instructions[i].m_opcode != VmOpcode::LABEL && !isJump(instructions[i]); ++i)
+      {
+        const VmInstruction& instruction = instructions[i];
+        if (instruction.m_segment == VmSegment::LOCAL && instruction.m_operand < function.m_operand && !seen[instruction.m_operand])
+        {
+          seen[instruction.m_operand] = true;
+          setBeforeRead[instruction.m_operand] = setBeforeRead[instruction.m_operand] || instruction.m_opcode == VmOpcode::POP;
+        }
+      }
+
+      std::uint32_t entryLabel = code.internName("ENTRY");
+      std::vector<VmInstruction> optimised(instructions.begin() + start, instructions.begin() + start + 1);
+      optimised.push_back({VmOpcode::LABEL, VmSegment::NONE, 0, entryLabel});
+      std::size_t nextTailCall = 0;
+      for (std::size_t i = start + 1; i < instructions.size(); ++i)
+      {
+        if (nextTailCall == tailCalls.size() || i != tailCalls[nextTailCall])
+        {
+          optimised.push_back(instructions[i]);
+          continue;
+        }
+
+        //the new arguments are all on the stack, so none of them is overwritten before it has been evaluated
+        for (unsigned argument = instructions[i].m_operand; argument > 0; --argument)
+          optimised.push_back({VmOpcode::POP, VmSegment::ARGUMENT, (std::uint16_t)(argument - 1), 0});
+        for (unsigned local = 0; local < function.m_operand; ++local)
+        {
+          if (!setBeforeRead[local])
+          {
+            optimised.push_back({VmOpcode::PUSH, VmSegment::CONSTANT, 0, 0});
+            optimised.push_back({VmOpcode::POP, VmSegment::LOCAL, (std::uint16_t)local, 0});
+          }
+        }
+        optimised.push_back({VmOpcode::GOTO, VmSegment::NONE, 0, entryLabel});
+        //the return after the call is never reached
+        ++i;
+        ++nextTailCall;
+        ++m_statistics.m_tailCallsRemoved;
+      }
+
+      instructions.resize(start);
+      instructions.insert(instructions.end(), optimised.begin(), optimised.end());
+    }
+
+    m_statistics.m_instructionsAfter[(int)OptimisationPass::TAIL_CALLS] += instructions.size() - start;
+  }
+}
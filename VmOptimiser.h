@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "VmCode.h"
+#include "BinaryData.h"
+
+namespace JackCompiler
+{
+  /**
+  * The passes run over the code of each subroutine when optimising, in the order they are run
+  */
+  enum class OptimisationPass
+  {
+    CONSTANT_FOLDING,
+    TAIL_CALLS,
+    STRENGTH_REDUCTION,
+    PEEPHOLE,
+    DEAD_CODE,
+    LABELS,
+    NUM_OPTIMISATION_PASSES
+  };
+
+  const char* getOptimisationPassName(OptimisationPass pass);
+
+  /**
+  * The number of instructions going into and coming out of each optimisation pass, the calls to the Math library that were
+  * replaced by cheaper code, the calls of subroutines to themselves that were turned into jumps, and what pooling string literals
+  * changed
+  */
+  struct OptimisationStatistics
+  {
+    std::uint64_t m_instructionsBefore[(int)OptimisationPass::NUM_OPTIMISATION_PASSES] = {};
+    std::uint64_t m_instructionsAfter[(int)OptimisationPass::NUM_OPTIMISATION_PASSES] = {};
+    std::uint64_t m_mathCallsRemoved = 0;
+    std::uint64_t m_tailCallsRemoved = 0;
+    //the string literals that were pooled and the distinct strings they share
+    std::uint64_t m_stringLiterals = 0;
+    std::uint64_t m_pooledStrings = 0;
+    //the instructions and calls building string literals, without and with pooling
+    std::uint64_t m_stringInstructionsBefore = 0;
+    std::uint64_t m_stringInstructionsAfter = 0;
+    std::uint64_t m_stringCallsBefore = 0;
+    std::uint64_t m_stringCallsAfter = 0;
+
+    /**
+    * Add the counts of another class or program
+    */
+    void merge(const OptimisationStatistics& statistics);
+    void serialise(std::string& data) const;
+    /**
+    * Read statistics written by serialise, returning false if they are not well formed
+    */
+    bool deserialise(BinaryReader& reader);
+  };
+
+  /**
+  * Return the statistics as lines for the console, one for each pass
+  */
+  std::string formatOptimisationStatistics(const OptimisationStatistics& statistics);
+
+  /**
+  * Rewrites the code of each subroutine, as soon as it has been generated, into code that behaves the same but runs fewer instructions
+  */
+  class VmOptimiser
+  {
+  public:
+    /**
+    * Optimise the subroutine whose function instruction is at start, which runs to the end of the code. The function instruction
+    * and the instructions directly after it that set up the subroutine are never moved, so their positions can still be patched
+    */
+    void optimiseSubroutine(VmCode& code, std::size_t start);
+    const OptimisationStatistics& getStatistics() const { return m_statistics; }
+
+  private:
+    /**
+    * Evaluate the operations on constants with the 16 bit wraparound of the Hack platform, and replace the local variables that are
+    * only ever set to a constant, before anything else can read them, with the constant
+    */
+    void runConstantFolding(VmCode& code, std::size_t start);
+    /**
+    * Replace each call a subroutine makes to itself right before returning with a jump back to its start, after moving the new
+    * arguments into the argument segment and clearing the local variables that may be read before they are set
+    */
+    void runTailCallElimination(VmCode& code, std::size_t start);
+    /**
+    * Remove the instructions that no path from the start of the subroutine reaches, such as the code after a return and the branches
+    * that a constant condition never takes. Removing them can leave jumps to the next instruction, so the peephole rules are applied
+    * again until nothing more is removed
+    */
+    void runDeadCodeElimination(VmCode& code, std::size_t start);
+    /**
+    * Point the jumps to a label that is followed by a goto at the goto's label instead, and remove the labels nothing jumps to, then
+    * name the labels that are left L0, L1 and so on in the order they appear
+    */
+    void runLabelSimplification(VmCode& code, std::size_t start);
+
+    OptimisationStatistics m_statistics;
+  };
+}
@@ -2,12 +2,23 @@
 //
 
 #include "Compiler.h"
+#include "CompileServer.h"
 #include <fstream>
 
 using namespace std;
 
 int main(int argc, char** argv)
 {
+  //A compile server keeps what it has read and compiled in memory between builds, and a client runs its build on the server
+  string mode = argc > 2 ? argv[1] : "";
+  if (mode == "--server" && argc == 3)
+    return JackCompiler::CompileServer(argv[2]).run();
+  if (mode == "--connect")
+  {
+    //the arguments after the socket path are passed on as the command line, with the socket path standing in for the program name
+    return JackCompiler::CompileServer::runClient(argv[2], argc - 2, argv + 2);
+  }
+
   //Create an object of the compiler class and run it, passing in the terminal arguments
 	JackCompiler::Compiler compiler;
 	return compiler.run(argc, argv);
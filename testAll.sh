@@ -1,26 +1,24 @@
-./build/JackCompiler "build/JackPrograms/Set 1/Square"
-./build/JackCompiler "build/JackPrograms/Set 1/List"
-./build/JackCompiler "build/JackPrograms/Set 1/HelloWorld"
-./build/JackCompiler "build/JackPrograms/Set 1/Fraction"
-./build/JackCompiler "build/JackPrograms/Set 1/Average"
-
-./build/JackCompiler "build/JackPrograms/Set 2/Square"
-./build/JackCompiler "build/JackPrograms/Set 2/ExpressionLessSquare"
-./build/JackCompiler "build/JackPrograms/Set 2/ArrayTest"
-
-./build/JackCompiler "build/JackPrograms/Set 3/Square"
-./build/JackCompiler "build/JackPrograms/Set 3/Seven"
-./build/JackCompiler "build/JackPrograms/Set 3/Pong"
-./build/JackCompiler "build/JackPrograms/Set 3/ConvertToBin"
-./build/JackCompiler "build/JackPrograms/Set 3/ComplexArrays"
-./build/JackCompiler "build/JackPrograms/Set 3/Average"
-
-./build/JackCompiler "build/JackPrograms/Set 4/"
-./build/JackCompiler "build/JackPrograms/Set 4/SysTest"
-./build/JackCompiler "build/JackPrograms/Set 4/StringTest"
-./build/JackCompiler "build/JackPrograms/Set 4/ScreenTest"
-./build/JackCompiler "build/JackPrograms/Set 4/OutputTest"
-./build/JackCompiler "build/JackPrograms/Set 4/MemoryTest"
-./build/JackCompiler "build/JackPrograms/Set 4/MathTest"
-./build/JackCompiler "build/JackPrograms/Set 4/KeyboardTest"
-./build/JackCompiler "build/JackPrograms/Set 4/ArrayTest"
\ No newline at end of file
+./build/JackCompiler \
+  "build/JackPrograms/Set 1/Square" \
+  "build/JackPrograms/Set 1/List" \
+  "build/JackPrograms/Set 1/HelloWorld" \
+  "build/JackPrograms/Set 1/Fraction" \
+  "build/JackPrograms/Set 1/Average" \
+  "build/JackPrograms/Set 2/Square" \
+  "build/JackPrograms/Set 2/ExpressionLessSquare" \
+  "build/JackPrograms/Set 2/ArrayTest" \
+  "build/JackPrograms/Set 3/Square" \
+  "build/JackPrograms/Set 3/Seven" \
+  "build/JackPrograms/Set 3/Pong" \
+  "build/JackPrograms/Set 3/ConvertToBin" \
+  "build/JackPrograms/Set 3/ComplexArrays" \
+  "build/JackPrograms/Set 3/Average" \
+  "build/JackPrograms/Set 4/" \
+  "build/JackPrograms/Set 4/SysTest" \
+  "build/JackPrograms/Set 4/StringTest" \
+  "build/JackPrograms/Set 4/ScreenTest" \
+  "build/JackPrograms/Set 4/OutputTest" \
+  "build/JackPrograms/Set 4/MemoryTest" \
+  "build/JackPrograms/Set 4/MathTest" \
+  "build/JackPrograms/Set 4/KeyboardTest" \
+  "build/JackPrograms/Set 4/ArrayTest"
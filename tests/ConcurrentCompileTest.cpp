@@ -0,0 +1,138 @@
+//Compiles copies of a sample project with separate Compiler instances on separate threads, all at once, and checks that every
+//copy gets the same vm files and messages as a compilation made on its own. Any state shared between compilations would show up
+//as a difference, such as a static variable given another index or a message printed by the wrong compiler
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stdexcept>
+
+#include "TestUtilities.h"
+
+using namespace JackCompiler::Tests;
+
+namespace
+{
+  const std::size_t s_numThreads = 16;
+  const std::size_t s_numRounds = 4;
+
+  struct Compilation
+  {
+    std::string m_directoryPath;
+    int m_result = -1;
+    std::string m_output;
+  };
+
+  /**
+  * Return the messages of the compilation with its directory path left out, so they can be compared with those of a copy
+  */
+  std::string getMessages(const Compilation& compilation)
+  {
+    std::string output = compilation.m_output;
+    for (std::size_t position = output.find(compilation.m_directoryPath); position != std::string::npos; position = output.find(compilation.m_directoryPath, position))
+      output.replace(position, compilation.m_directoryPath.size(), "<directory>");
+    return output;
+  }
+
+  /**
+  * Compile the sample in its own directory, then again in one directory per thread with all the threads running together,
+  * returning the number of compilations that differed from the first
+  */
+  std::size_t testOptions(const std::string& samplePath, const std::string& workingPath, const std::vector<std::string>& options)
+  {
+    std::string name = options.empty() ? " (none)" : "";
+    for (const std::string& option : options)
+      name += " " + option;
+
+    Compilation expected;
+    expected.m_directoryPath = workingPath + "/expected";
+    copyJackFiles(samplePath, expected.m_directoryPath);
+    std::vector<std::string> arguments = options;
+    arguments.push_back(expected.m_directoryPath);
+    expected.m_result = runCompiler(arguments, expected.m_output);
+    std::map<std::string, std::string> expectedFiles = readVmFiles(expected.m_directoryPath);
+    std::string expectedMessages = getMessages(expected);
+    if (expected.m_result != 0 || expectedFiles.empty())
+      throw std::runtime_error("The sample did not compile with the options" + name + ":\n" + expected.m_output);
+
+    std::size_t numFailed = 0;
+    for (std::size_t round = 0; round < s_numRounds; round++)
+    {
+      std::vector<Compilation> compilations(s_numThreads);
+      std::vector<std::thread> threads;
+      for (std::size_t i = 0; i < s_numThreads; i++)
+      {
+        compilations[i].m_directoryPath = workingPath + "/copy" + std::to_string(i);
+        copyJackFiles(samplePath, compilations[i].m_directoryPath);
+      }
+      for (Compilation& compilation : compilations)
+      {
+        threads.emplace_back([&compilation, &options]()
+        {
+          std::vector<std::string> arguments = options;
+          arguments.push_back(compilation.m_directoryPath);
+          compilation.m_result = runCompiler(arguments, compilation.m_output);
+        });
+      }
+      for (std::thread& thread : threads)
+        thread.join();
+
+      for (Compilation& compilation : compilations)
+      {
+        std::string difference;
+        if (compilation.m_result != expected.m_result)
+          difference = "exit status " + std::to_string(compilation.m_result);
+        else if (getMessages(compilation) != expectedMessages)
+          difference = "messages:\n" + compilation.m_output;
+        else if (readVmFiles(compilation.m_directoryPath) != expectedFiles)
+          difference = "vm files";
+
+        if (!difference.empty())
+        {
+          std::cerr << "FAILED:" << name << ": " << compilation.m_directoryPath << " has different " << difference << std::endl;
+          numFailed++;
+        }
+        removeDirectory(compilation.m_directoryPath);
+      }
+    }
+
+    removeDirectory(expected.m_directoryPath);
+    return numFailed;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: ConcurrentCompileTest <sample project directory>" << std::endl;
+    return 2;
+  }
+
+  std::string workingPath;
+  try
+  {
+    workingPath = makeTemporaryDirectory();
+    //the optimisations and whole program passes have state of their own, so they are run as well
+    const std::vector<std::vector<std::string>> optionSets = {
+      {},
+      { "-O", "--pool-strings" },
+      { "--inline" }
+    };
+    std::size_t numFailed = 0;
+    for (const std::vector<std::string>& options : optionSets)
+      numFailed += testOptions(argv[1], workingPath, options);
+    removeDirectory(workingPath);
+
+    if (numFailed != 0)
+      return 1;
+    std::cout << "Compiled the sample " << optionSets.size() * s_numRounds * s_numThreads << " times on " << s_numThreads << " threads with identical output" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& exception)
+  {
+    std::cerr << "FAILED: " << exception.what() << std::endl;
+    removeDirectory(workingPath);
+    return 1;
+  }
+}
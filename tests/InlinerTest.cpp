@@ -0,0 +1,90 @@
+//Compiles a sample program with and without --inline and runs both in a small vm interpreter, checking that each prints what the
+//program should. The sample stores the results of inlined methods into arrays, which needs that to survive the inlined code, and
+//calls a constructor, which must never be inlined
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "TestUtilities.h"
+#include "VmInterpreter.h"
+
+using namespace JackCompiler::Tests;
+
+namespace
+{
+  const std::string s_expectedOutput = "1\n3\n12\n34\n3\n10\n34\n";
+  const std::size_t s_maxSteps = 100000;
+
+  /**
+  * Compile a copy of the sample with the options and run it, returning the number of problems found
+  */
+  std::size_t testOptions(const std::string& samplePath, const std::string& workingPath, const std::vector<std::string>& options)
+  {
+    std::string name;
+    for (const std::string& option : options)
+      name += " " + option;
+
+    std::map<std::string, std::string> files = compileCopy(samplePath, workingPath + "/sample", options);
+
+    std::size_t numFailed = 0;
+    std::string output = VmInterpreter(files).run(s_maxSteps);
+    if (output != s_expectedOutput)
+    {
+      std::cerr << "FAILED:" << name << ": the program printed\n" << output << "instead of\n" << s_expectedOutput;
+      numFailed++;
+    }
+    return numFailed;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: InlinerTest <sample project directory>" << std::endl;
+    return 2;
+  }
+
+  std::string workingPath;
+  try
+  {
+    workingPath = makeTemporaryDirectory();
+    std::size_t numFailed = 0;
+    numFailed += testOptions(argv[1], workingPath, { "--no-cache" });
+    numFailed += testOptions(argv[1], workingPath, { "--no-cache", "--inline" });
+    numFailed += testOptions(argv[1], workingPath, { "--no-cache", "-O", "--inline" });
+
+    //the methods are inlined, but not the constructor
+    std::string directoryPath = workingPath + "/sample";
+    copyJackFiles(argv[1], directoryPath);
+    std::string messages;
+    runCompiler({ "--no-cache", "--inline", directoryPath }, messages);
+    for (const char* subroutine : { "Point.getX", "Point.sum" })
+    {
+      if (messages.find("  " + std::string(subroutine) + "\n") == std::string::npos)
+      {
+        std::cerr << "FAILED: " << subroutine << " was not inlined" << std::endl;
+        numFailed++;
+      }
+    }
+    if (readVmFiles(directoryPath).at("Main.vm").find("call Point.new") == std::string::npos)
+    {
+      std::cerr << "FAILED: the constructor Point.new was inlined" << std::endl;
+      numFailed++;
+    }
+    removeDirectory(workingPath);
+
+    if (numFailed != 0)
+      return 1;
+    std::cout << "The sample printed the same with and without inlining" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& exception)
+  {
+    std::cerr << "FAILED: " << exception.what() << std::endl;
+    removeDirectory(workingPath);
+    return 1;
+  }
+}
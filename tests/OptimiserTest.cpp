@@ -0,0 +1,75 @@
+//Compiles a sample program without optimisation and then with each combination of optimisations, running every build in a small
+//vm interpreter and checking that it prints what the unoptimised build prints. The sample branches on conditions that are neither
+//0 nor -1, which the optimiser must not treat as booleans
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "TestUtilities.h"
+#include "VmInterpreter.h"
+
+using namespace JackCompiler::Tests;
+
+namespace
+{
+  const std::string s_expectedOutput = "1\n2\n3\n4\n6\n10\n";
+  const std::size_t s_maxSteps = 100000;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: OptimiserTest <sample project directory>" << std::endl;
+    return 2;
+  }
+
+  std::string workingPath;
+  try
+  {
+    workingPath = makeTemporaryDirectory();
+    const std::vector<std::vector<std::string>> optionSets = {
+      { "--no-cache" },
+      { "--no-cache", "-O" },
+      { "--no-cache", "-O", "--pool-strings" },
+      { "--no-cache", "-O", "--inline" },
+      { "--no-cache", "-O", "-j4", "--whole-program" }
+    };
+    std::size_t numFailed = 0;
+    for (const std::vector<std::string>& options : optionSets)
+    {
+      std::string name;
+      for (const std::string& option : options)
+        name += " " + option;
+
+      std::string output;
+      try
+      {
+        output = VmInterpreter(compileCopy(argv[1], workingPath + "/sample", options)).run(s_maxSteps);
+      }
+      catch (const std::runtime_error& error)
+      {
+        output = error.what() + std::string("\n");
+      }
+      if (output != s_expectedOutput)
+      {
+        std::cerr << "FAILED:" << name << ": the program printed\n" << output << "instead of\n" << s_expectedOutput;
+        numFailed++;
+      }
+    }
+    removeDirectory(workingPath);
+
+    if (numFailed != 0)
+      return 1;
+    std::cout << "The sample printed the same with every optimisation" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& exception)
+  {
+    std::cerr << "FAILED: " << exception.what() << std::endl;
+    removeDirectory(workingPath);
+    return 1;
+  }
+}
@@ -0,0 +1,110 @@
+//Builds a sample project with warnings, then builds it again, once with nothing changed and once with one file changed, and
+//checks that every build reports the same warnings. Files reused from the manifest are not compiled again, so their warnings
+//have to be reported from the manifest
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <stdexcept>
+
+#include "TestUtilities.h"
+
+using namespace JackCompiler::Tests;
+
+namespace
+{
+  struct Build
+  {
+    int m_result = -1;
+    std::string m_output;
+    std::string m_diagnostics;
+  };
+
+  /**
+  * Build the project in the directory with the options, keeping what it printed and the diagnostics it wrote
+  */
+  Build build(const std::string& directoryPath, const std::string& diagnosticsPath, const std::vector<std::string>& options)
+  {
+    Build build;
+    std::vector<std::string> arguments = options;
+    arguments.insert(arguments.end(), { "--diagnostics-json", diagnosticsPath, directoryPath });
+    build.m_result = runCompiler(arguments, build.m_output);
+
+    std::ifstream file(diagnosticsPath, std::ios_base::binary);
+    build.m_diagnostics.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return build;
+  }
+
+  /**
+  * Build a copy of the sample three times with the options, returning the number of builds reporting something different
+  */
+  std::size_t testOptions(const std::string& samplePath, const std::string& workingPath, const std::vector<std::string>& options)
+  {
+    std::string name;
+    for (const std::string& option : options)
+      name += " " + option;
+
+    std::string directoryPath = workingPath + "/sample";
+    std::string diagnosticsPath = workingPath + "/diagnostics.json";
+    copyJackFiles(samplePath, directoryPath);
+    Build expected = build(directoryPath, diagnosticsPath, options);
+    if (expected.m_result != 0 || expected.m_diagnostics.empty())
+      throw std::runtime_error("The sample did not build with warnings with the options" + name + ":\n" + expected.m_output);
+
+    std::size_t numFailed = 0;
+    for (const char* change : { "nothing changed", "Main.jack changed" })
+    {
+      if (std::string(change) == "Main.jack changed")
+        std::ofstream(directoryPath + "/Main.jack", std::ios_base::app) << "//changed\n";
+
+      Build rebuild = build(directoryPath, diagnosticsPath, options);
+      std::string difference;
+      if (rebuild.m_result != expected.m_result)
+        difference = "exit status " + std::to_string(rebuild.m_result);
+      else if (rebuild.m_output != expected.m_output)
+        difference = "messages:\n" + rebuild.m_output;
+      else if (rebuild.m_diagnostics != expected.m_diagnostics)
+        difference = "diagnostics:\n" + rebuild.m_diagnostics;
+
+      if (!difference.empty())
+      {
+        std::cerr << "FAILED:" << name << ": the build with " << change << " has different " << difference << std::endl;
+        numFailed++;
+      }
+    }
+
+    removeDirectory(directoryPath);
+    return numFailed;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    std::cerr << "Usage: RebuildTest <sample project directory>" << std::endl;
+    return 2;
+  }
+
+  std::string workingPath;
+  try
+  {
+    workingPath = makeTemporaryDirectory();
+    std::size_t numFailed = 0;
+    numFailed += testOptions(argv[1], workingPath, { "-q" });
+    numFailed += testOptions(argv[1], workingPath, { "-q", "-j4" });
+    removeDirectory(workingPath);
+
+    if (numFailed != 0)
+      return 1;
+    std::cout << "Every build of the sample reported the same warnings" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& exception)
+  {
+    std::cerr << "FAILED: " << exception.what() << std::endl;
+    removeDirectory(workingPath);
+    return 1;
+  }
+}
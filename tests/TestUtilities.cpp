@@ -0,0 +1,143 @@
+#include "TestUtilities.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Compiler.h"
+
+namespace JackCompiler
+{
+  namespace Tests
+  {
+    namespace
+    {
+      /**
+      * Return the names of the files in the directory with the given extension
+      */
+      std::vector<std::string> findFiles(const std::string& directoryPath, const std::string& extension)
+      {
+        DIR* directory = opendir(directoryPath.c_str());
+        if (directory == NULL)
+          throw std::runtime_error("Unable to open the directory '" + directoryPath + "'");
+
+        std::vector<std::string> names;
+        for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+        {
+          std::string name = entry->d_name;
+          if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+            names.push_back(name);
+        }
+        closedir(directory);
+        return names;
+      }
+
+      bool readFile(const std::string& filePath, std::string& data)
+      {
+        std::ifstream file(filePath, std::ios_base::binary);
+        if (!file.is_open())
+          return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+      }
+
+      bool writeFile(const std::string& filePath, const std::string& data)
+      {
+        std::ofstream file(filePath, std::ios_base::binary);
+        return file.write(data.data(), data.size()).good();
+      }
+    }
+
+    std::string makeTemporaryDirectory()
+    {
+      const char* temporaryDirectory = std::getenv("TMPDIR");
+      std::string pathTemplate = std::string(temporaryDirectory ? temporaryDirectory : "/tmp") + "/JackCompilerTest.XXXXXX";
+      std::vector<char> path(pathTemplate.begin(), pathTemplate.end());
+      path.push_back('\0');
+      if (mkdtemp(path.data()) == NULL)
+        throw std::runtime_error("Unable to create a temporary directory from '" + pathTemplate + "'");
+      return path.data();
+    }
+
+    void removeDirectory(const std::string& directoryPath)
+    {
+      DIR* directory = opendir(directoryPath.c_str());
+      if (directory == NULL)
+        return;
+      for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+      {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+          continue;
+        std::string path = directoryPath + "/" + name;
+        if (entry->d_type == DT_DIR)
+          removeDirectory(path);
+        else
+          std::remove(path.c_str());
+      }
+      closedir(directory);
+      rmdir(directoryPath.c_str());
+    }
+
+    void copyJackFiles(const std::string& fromPath, const std::string& toPath)
+    {
+      mkdir(toPath.c_str(), 0777);
+      for (const std::string& name : findFiles(fromPath, ".jack"))
+      {
+        std::string data;
+        if (!readFile(fromPath + "/" + name, data) || !writeFile(toPath + "/" + name, data))
+          throw std::runtime_error("Unable to copy the file '" + fromPath + "/" + name + "'");
+      }
+    }
+
+    std::map<std::string, std::string> readVmFiles(const std::string& directoryPath)
+    {
+      std::map<std::string, std::string> files;
+      for (const std::string& name : findFiles(directoryPath, ".vm"))
+      {
+        if (!readFile(directoryPath + "/" + name, files[name]))
+          throw std::runtime_error("Unable to read the file '" + directoryPath + "/" + name + "'");
+      }
+      return files;
+    }
+
+    int runCompiler(const std::vector<std::string>& arguments, std::string& output)
+    {
+      std::vector<std::string> commandLine(1, "JackCompiler");
+      commandLine.insert(commandLine.end(), arguments.begin(), arguments.end());
+      std::vector<char*> argv;
+      for (std::string& argument : commandLine)
+        argv.push_back(&argument[0]);
+      argv.push_back(nullptr);
+
+      std::ostringstream stream;
+      int result = Compiler(stream).run(commandLine.size(), argv.data());
+      output = stream.str();
+      return result;
+    }
+
+    std::map<std::string, std::string> compileCopy(const std::string& samplePath, const std::string& directoryPath, const std::vector<std::string>& options)
+    {
+      copyJackFiles(samplePath, directoryPath);
+      std::vector<std::string> arguments = options;
+      arguments.push_back(directoryPath);
+      std::string messages;
+      if (runCompiler(arguments, messages) != 0)
+      {
+        std::string name;
+        for (const std::string& option : options)
+          name += " " + option;
+        throw std::runtime_error("The sample did not compile with the options" + name + ":\n" + messages);
+      }
+      std::map<std::string, std::string> files = readVmFiles(directoryPath);
+      removeDirectory(directoryPath);
+      return files;
+    }
+  }
+}
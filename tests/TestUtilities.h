@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+
+namespace JackCompiler
+{
+  namespace Tests
+  {
+    /**
+    * Create an empty directory under the system's temporary directory and return its path
+    */
+    std::string makeTemporaryDirectory();
+    /**
+    * Delete the directory at directoryPath along with the files in it
+    */
+    void removeDirectory(const std::string& directoryPath);
+    /**
+    * Copy every jack file in the directory at fromPath into the directory at toPath, creating it if needed
+    */
+    void copyJackFiles(const std::string& fromPath, const std::string& toPath);
+    /**
+    * Return the contents of every vm file in the directory, keyed by file name
+    */
+    std::map<std::string, std::string> readVmFiles(const std::string& directoryPath);
+    /**
+    * Run a compiler with the arguments, as if they followed the program name on the command line, storing what it printed in
+    * output. Returns the compiler's exit status
+    */
+    int runCompiler(const std::vector<std::string>& arguments, std::string& output);
+    /**
+    * Compile a copy of the jack files at samplePath, made in directoryPath, with the options and return its vm files. The copy is
+    * removed afterwards. Throws if the copy does not compile
+    */
+    std::map<std::string, std::string> compileCopy(const std::string& samplePath, const std::string& directoryPath, const std::vector<std::string>& options);
+  }
+}
@@ -0,0 +1,161 @@
+#include "VmInterpreter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace JackCompiler
+{
+  namespace Tests
+  {
+    VmInterpreter::VmInterpreter(const std::map<std::string, std::string>& files)
+    {
+      unsigned staticBase = 16;
+      for (const auto& file : files)
+      {
+        VmCode code;
+        if (!code.parseText(file.second))
+          throw std::runtime_error("Unable to read the vm code in the file '" + file.first + "'");
+
+        std::string function;
+        unsigned numStatics = 0;
+        for (const VmInstruction& instruction : code.getInstructions())
+        {
+          std::string name = instruction.m_nameId < code.getNames().size() ? code.getName(instruction.m_nameId) : "";
+          if (instruction.m_opcode == VmOpcode::FUNCTION)
+          {
+            function = name;
+            m_functions[name] = m_instructions.size();
+          }
+          else if (instruction.m_opcode == VmOpcode::LABEL)
+            m_labels[function + "$" + name] = m_instructions.size();
+          if (instruction.m_segment == VmSegment::STATIC && instruction.m_operand + 1u > numStatics)
+            numStatics = instruction.m_operand + 1;
+          m_instructions.push_back({instruction, function, name, staticBase});
+        }
+        staticBase += numStatics;
+      }
+    }
+
+    std::string VmInterpreter::run(std::size_t maxSteps)
+    {
+      m_ram.assign(32768, 0);
+      m_ram[SP] = 256;
+      m_heapEnd = 2048;
+      m_output.clear();
+      call("Main.main", 0, m_instructions.size());
+      for (std::size_t steps = 0; m_pc < m_instructions.size(); ++steps)
+      {
+        if (steps == maxSteps)
+          throw std::runtime_error("The program did not finish");
+        execute(m_instructions[m_pc++]);
+      }
+      return m_output;
+    }
+
+    std::int16_t& VmInterpreter::getAddress(const Instruction& instruction)
+    {
+      unsigned index = instruction.m_instruction.m_operand;
+      switch (instruction.m_instruction.m_segment)
+      {
+        case VmSegment::ARGUMENT: return m_ram[m_ram[ARG] + index];
+        case VmSegment::LOCAL:    return m_ram[m_ram[LCL] + index];
+        case VmSegment::STATIC:   return m_ram[instruction.m_staticBase + index];
+        case VmSegment::THIS:     return m_ram[m_ram[THIS] + index];
+        case VmSegment::THAT:     return m_ram[m_ram[THAT] + index];
+        case VmSegment::POINTER:  return m_ram[THIS + index];
+        case VmSegment::TEMP:     return m_ram[5 + index];
+        default: throw std::runtime_error("Invalid segment in " + instruction.m_function);
+      }
+    }
+
+    void VmInterpreter::call(const std::string& name, unsigned numArguments, std::size_t returnAddress)
+    {
+      auto function = m_functions.find(name);
+      if (function != m_functions.end())
+      {
+        Frame frame {returnAddress, {}};
+        std::copy(m_ram.begin(), m_ram.begin() + THAT + 1, frame.m_registers);
+        m_frames.push_back(frame);
+        m_ram[ARG] = m_ram[SP] - numArguments;
+        m_ram[LCL] = m_ram[SP];
+        m_pc = function->second;
+        return;
+      }
+
+      std::vector<std::int16_t> arguments(numArguments);
+      for (unsigned i = numArguments; i > 0; --i)
+        arguments[i - 1] = pop();
+      if ((name == "Memory.alloc" || name == "Array.new") && numArguments == 1)
+      {
+        push(m_heapEnd);
+        m_heapEnd += arguments[0];
+      }
+      else if (name == "Output.printInt" && numArguments == 1)
+      {
+        m_output += std::to_string(arguments[0]);
+        push(0);
+      }
+      else if (name == "Output.printLn" && numArguments == 0)
+      {
+        m_output += "\n";
+        push(0);
+      }
+      else
+        throw std::runtime_error("Call to the unknown subroutine " + name);
+    }
+
+    void VmInterpreter::execute(const Instruction& instruction)
+    {
+      std::int16_t value;
+      switch (instruction.m_instruction.m_opcode)
+      {
+        case VmOpcode::PUSH:
+          value = instruction.m_instruction.m_segment == VmSegment::CONSTANT ? instruction.m_instruction.m_operand : getAddress(instruction);
+          push(value);
+          break;
+        case VmOpcode::POP:
+          value = pop();
+          getAddress(instruction) = value;
+          break;
+        case VmOpcode::ADD: value = pop(); push(pop() + value); break;
+        case VmOpcode::SUB: value = pop(); push(pop() - value); break;
+        case VmOpcode::AND: value = pop(); push(pop() & value); break;
+        case VmOpcode::OR:  value = pop(); push(pop() | value); break;
+        case VmOpcode::EQ:  value = pop(); push(pop() == value ? -1 : 0); break;
+        case VmOpcode::GT:  value = pop(); push(pop() > value ? -1 : 0); break;
+        case VmOpcode::LT:  value = pop(); push(pop() < value ? -1 : 0); break;
+        case VmOpcode::NEG: push(-pop()); break;
+        case VmOpcode::NOT: push(~pop()); break;
+        case VmOpcode::LABEL: break;
+        case VmOpcode::GOTO:
+          m_pc = m_labels.at(instruction.m_function + "$" + instruction.m_name);
+          break;
+        case VmOpcode::IF_GOTO:
+          if (pop() != 0)
+            m_pc = m_labels.at(instruction.m_function + "$" + instruction.m_name);
+          break;
+        case VmOpcode::FUNCTION:
+          for (unsigned i = 0; i < instruction.m_instruction.m_operand; ++i)
+            push(0);
+          break;
+        case VmOpcode::CALL:
+          call(instruction.m_name, instruction.m_instruction.m_operand, m_pc);
+          break;
+        case VmOpcode::RETURN:
+        {
+          value = pop();
+          std::int16_t argument = m_ram[ARG];
+          Frame frame = m_frames.back();
+          m_frames.pop_back();
+          std::copy(frame.m_registers, frame.m_registers + THAT + 1, m_ram.begin());
+          m_ram[SP] = argument;
+          push(value);
+          m_pc = frame.m_returnAddress;
+          break;
+        }
+        default:
+          throw std::runtime_error("Invalid instruction in " + instruction.m_function);
+      }
+    }
+  }
+}
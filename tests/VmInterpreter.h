@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <cstdint>
+
+#include "../VmCode.h"
+
+namespace JackCompiler
+{
+  namespace Tests
+  {
+    /**
+    * Runs the vm code of a program from Main.main, with just enough of the operating system to allocate memory and print numbers.
+    * The registers and segments are laid out as on the Hack platform, but the saved frames of calls are kept apart from the stack
+    */
+    class VmInterpreter
+    {
+    public:
+      /**
+      * Load the program from the text of its vm files, keyed by file name
+      */
+      VmInterpreter(const std::map<std::string, std::string>& files);
+      /**
+      * Run the program and return what it printed. Throws if it runs for more than maxSteps instructions
+      */
+      std::string run(std::size_t maxSteps);
+
+    private:
+      enum Register { SP, LCL, ARG, THIS, THAT };
+
+      struct Instruction
+      {
+        VmInstruction m_instruction;
+        std::string m_function;
+        std::string m_name;
+        unsigned m_staticBase;
+      };
+
+      struct Frame
+      {
+        std::size_t m_returnAddress;
+        std::int16_t m_registers[THAT + 1];
+      };
+
+      std::int16_t pop() { return m_ram[--m_ram[SP]]; }
+      void push(int value) { m_ram[m_ram[SP]++] = static_cast<std::int16_t>(value); }
+      std::int16_t& getAddress(const Instruction& instruction);
+      void call(const std::string& name, unsigned numArguments, std::size_t returnAddress);
+      void execute(const Instruction& instruction);
+
+      std::vector<Instruction> m_instructions;
+      std::map<std::string, std::size_t> m_functions;
+      std::map<std::string, std::size_t> m_labels;
+      std::vector<std::int16_t> m_ram;
+      std::vector<Frame> m_frames;
+      std::size_t m_pc = 0;
+      int m_heapEnd = 2048;
+      std::string m_output;
+    };
+  }
+}